@@ -21,6 +21,7 @@ char *tinyascii_p7;
 char *tinyascii_p8;
 char *tinyascii_p9;
 
+#if ENABLE_ASCII_ART
 char *a_p1 = "  __ _      ";
 char *a_p2 = " / _` |     ";
 char *a_p3 = "| (_| |     ";
@@ -130,3 +131,4 @@ char *k_p6 = "            ";
 char *k_p7 = "            ";
 char *k_p8 = "            ";
 char *k_p9 = "            ";
+#endif
@@ -8,17 +8,38 @@
 */
 
 #include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <limits.h>
+#include <pthread.h>
+#include <pwd.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/utsname.h>
+#include <time.h>
 #include <unistd.h>
 #ifdef __linux__
+#include <arpa/inet.h>
 #include <linux/kernel.h>
+#include <linux/perf_event.h>
+#include <linux/rtnetlink.h>
+#include <net/if.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <sys/statvfs.h>
+#include <sys/syscall.h>
 #include <sys/sysinfo.h>
 #endif
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+#if defined(__aarch64__) && defined(__linux__)
+#include <asm/hwcap.h>
+#include <sys/auxv.h>
+#endif
 #if defined(__NetBSD__)
 #include <sys/swap.h>
 #include <sys/sysctl.h>
@@ -31,6 +52,123 @@
 #include <time.h>
 #endif
 #include "config.h"
+// builds without meson's config.h get every collector
+#ifndef ENABLE_USER
+#define ENABLE_USER 1
+#endif
+#ifndef ENABLE_OS
+#define ENABLE_OS 1
+#endif
+#ifndef ENABLE_DISTRO
+#define ENABLE_DISTRO 1
+#endif
+#ifndef ENABLE_KERNEL
+#define ENABLE_KERNEL 1
+#endif
+#ifndef ENABLE_SHELL
+#define ENABLE_SHELL 1
+#endif
+#ifndef ENABLE_UPTIME
+#define ENABLE_UPTIME 1
+#endif
+#ifndef ENABLE_WM
+#define ENABLE_WM 1
+#endif
+#ifndef ENABLE_CPU
+#define ENABLE_CPU 1
+#endif
+#ifndef ENABLE_GPU
+#define ENABLE_GPU 1
+#endif
+#ifndef ENABLE_RAM
+#define ENABLE_RAM 1
+#endif
+#ifndef ENABLE_SWAP
+#define ENABLE_SWAP 1
+#endif
+#ifndef ENABLE_PROMETHEUS
+#define ENABLE_PROMETHEUS 1
+#endif
+#ifndef ENABLE_CPU_USAGE
+#define ENABLE_CPU_USAGE 1
+#endif
+#ifndef ENABLE_NUMA
+#define ENABLE_NUMA 1
+#endif
+#ifndef ENABLE_TOPOLOGY
+#define ENABLE_TOPOLOGY 1
+#endif
+#ifndef ENABLE_ISA
+#define ENABLE_ISA 1
+#endif
+#ifndef ENABLE_HUGEPAGES
+#define ENABLE_HUGEPAGES 1
+#endif
+#ifndef ENABLE_PRESSURE
+#define ENABLE_PRESSURE 1
+#endif
+#ifndef ENABLE_CGROUP
+#define ENABLE_CGROUP 1
+#endif
+#ifndef ENABLE_TOP
+#define ENABLE_TOP 1
+#endif
+#ifndef ENABLE_IRQ
+#define ENABLE_IRQ 1
+#endif
+#ifndef ENABLE_STORAGE
+#define ENABLE_STORAGE 1
+#endif
+#ifndef ENABLE_DISK
+#define ENABLE_DISK 1
+#endif
+#ifndef ENABLE_NET
+#define ENABLE_NET 1
+#endif
+#ifndef ENABLE_THERMAL
+#define ENABLE_THERMAL 1
+#endif
+#ifndef ENABLE_MITIGATIONS
+#define ENABLE_MITIGATIONS 1
+#endif
+#ifndef ENABLE_TUNING
+#define ENABLE_TUNING 1
+#endif
+#ifndef ENABLE_LATENCY
+#define ENABLE_LATENCY 1
+#endif
+#ifndef ENABLE_HWPROBE
+#define ENABLE_HWPROBE 1
+#endif
+#ifndef ENABLE_PERF_STAT
+#define ENABLE_PERF_STAT 1
+#endif
+#ifndef ENABLE_BATCH
+#define ENABLE_BATCH 1
+#endif
+#ifndef ENABLE_ASCII_ART
+#define ENABLE_ASCII_ART 1
+#endif
+#ifndef ENABLE_RANDOM_STRINGS
+#define ENABLE_RANDOM_STRINGS 1
+#endif
+#ifndef ENABLE_HELP_TEXT
+#define ENABLE_HELP_TEXT 1
+#endif
+#ifndef ENABLE_USDT
+#define ENABLE_USDT 0
+#endif
+#if ENABLE_USDT
+#include <sys/sdt.h>
+#define TINY_PROBE(name) DTRACE_PROBE(tinyfetch, name)
+#define TINY_PROBE1(name, a) DTRACE_PROBE1(tinyfetch, name, a)
+#define TINY_PROBE2(name, a, b) DTRACE_PROBE2(tinyfetch, name, a, b)
+#else
+// sizeof keeps the arguments "used" without evaluating them
+#define TINY_PROBE(name) ((void)0)
+#define TINY_PROBE1(name, a) ((void)sizeof(a))
+#define TINY_PROBE2(name, a, b) ((void)sizeof(a), (void)sizeof(b))
+#endif
 #include "tinyascii.h"
 #include "tinyfetch.h"
 #if defined(__linux__) || defined(__FreeBSD__) || defined(__NetBSD__)
@@ -45,80 +183,101 @@
 
 int file_parser(const char *file, const char *line_to_read) {
   char resolved_path[PATH_MAX];
+  TINY_PROBE2(file_parser__entry, file, line_to_read);
   if (realpath(file, resolved_path) == NULL) {
     perror("realpath");
+    TINY_PROBE2(file_parser__return, file, -1L);
     return -1;
   }
 
   FILE *meminfo = fopen(resolved_path, "r");
   if (meminfo == NULL) {
     perror("fopen");
+    TINY_PROBE2(file_parser__return, file, -1L);
     return -1;
   }
 
   char line[256];
+  long bytes = 0; // for the probe, without an lseek when nobody traces
   while (fgets(line, sizeof(line), meminfo)) {
+    bytes += strlen(line);
     int ram;
     if (sscanf(line, line_to_read, &ram) == 1) {
+      TINY_PROBE2(file_parser__return, file, bytes);
       fclose(meminfo);
       return ram;
     }
   }
 
+  TINY_PROBE2(file_parser__return, file, bytes);
   fclose(meminfo);
   return -1;
 }
 
 double file_parser_double(const char *file, const char *line_to_read) {
   char resolved_path[PATH_MAX];
+  TINY_PROBE2(file_parser__entry, file, line_to_read);
   if (realpath(file, resolved_path) == NULL) {
     perror("realpath");
+    TINY_PROBE2(file_parser__return, file, -1L);
     return -1.0;
   }
 
   FILE *meminfo = fopen(resolved_path, "r");
   if (meminfo == NULL) {
     perror("fopen");
+    TINY_PROBE2(file_parser__return, file, -1L);
     return -1.0;
   }
 
   char line[256];
+  long bytes = 0;
   while (fgets(line, sizeof(line), meminfo)) {
+    bytes += strlen(line);
     double ram;
     if (sscanf(line, line_to_read, &ram) == 1) {
+      TINY_PROBE2(file_parser__return, file, bytes);
       fclose(meminfo);
       return ram;
     }
   }
 
+  TINY_PROBE2(file_parser__return, file, bytes);
   fclose(meminfo);
   return -1.0;
 }
 
 char *file_parser_char(const char *file, const char *line_to_read) {
   char resolved_path[PATH_MAX];
+  TINY_PROBE2(file_parser__entry, file, line_to_read);
   if (realpath(file, resolved_path) == NULL) {
     perror("realpath");
+    TINY_PROBE2(file_parser__return, file, -1L);
     return NULL;
   }
 
   FILE *meminfo = fopen(resolved_path, "r");
   if (meminfo == NULL) {
     perror("fopen");
+    TINY_PROBE2(file_parser__return, file, -1L);
     return NULL;
   }
 
   char line[256];
   char *parsed_string = NULL;
+  long bytes = 0;
   while (fgets(line, sizeof(line), meminfo)) {
+    bytes += strlen(line);
     parsed_string = (char *)malloc(strlen(line) + 1);
     if (!parsed_string) {
       perror("malloc");
+      TINY_PROBE2(file_parser__return, file, bytes);
       fclose(meminfo);
       return NULL;
     }
 
     if (sscanf(line, line_to_read, parsed_string) == 1) {
+      TINY_PROBE2(file_parser__return, file, bytes);
       fclose(meminfo);
       return parsed_string;
     }
@@ -126,10 +285,175 @@ char *file_parser_char(const char *file, const char *line_to_read) {
     free(parsed_string);
   }
 
+  TINY_PROBE2(file_parser__return, file, bytes);
   fclose(meminfo);
   return NULL;
 }
 
+// reads a small file with a single read() and NUL-terminates it. dirfd may be
+// AT_FDCWD. returns the number of bytes read or -1.
+ssize_t file_read_at(int dirfd, const char *path, char *buf, size_t size) {
+  int fd = openat(dirfd, path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return -1;
+  }
+  ssize_t n = read(fd, buf, size - 1);
+  close(fd);
+  if (n < 0) {
+    return -1;
+  }
+  buf[n] = '\0';
+  return n;
+}
+
+// reads all of path into *buf, growing it with realloc (*cap is its size).
+// seq_files like mountinfo hand out about a page per read(), so this loops
+// until EOF. returns the length, or -1 with errno EFBIG past max bytes.
+ssize_t file_read_all(int dirfd, const char *path, char **buf, size_t *cap,
+                      size_t max) {
+  int fd = openat(dirfd, path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return -1;
+  }
+  size_t len = 0;
+  for (;;) {
+    if (*cap - len < 4096) {
+      size_t new_cap = (*cap < 16384) ? 16384 : *cap * 2;
+      char *grown = realloc(*buf, new_cap);
+      if (grown == NULL) {
+        close(fd);
+        return -1;
+      }
+      *buf = grown;
+      *cap = new_cap;
+    }
+    ssize_t n = read(fd, *buf + len, *cap - len - 1);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      close(fd);
+      if (n < 0) {
+        return -1;
+      }
+      break;
+    }
+    len += n;
+    if (len > max) {
+      close(fd);
+      errno = EFBIG;
+      return -1;
+    }
+  }
+  (*buf)[len] = '\0';
+  return len;
+}
+
+// parses an unsigned decimal at *p, skipping leading blanks (but not
+// newlines), and leaves *p just past it.
+unsigned long long parse_ull(char **p) {
+  char *c = *p;
+  while (*c == ' ' || *c == '\t') {
+    c++;
+  }
+  unsigned long long value = 0;
+  while (*c >= '0' && *c <= '9') {
+    value = value * 10 + (*c - '0');
+    c++;
+  }
+  (*p) = c;
+  return value;
+}
+
+// parses a kernel cpulist ("0-3,8,10-11", or "0-15:2/4" for the first two
+// of every four) into a bitset of nbits bits and returns how many CPUs it
+// names.
+int cpulist_parse(char *list, unsigned long long *set, int nbits) {
+  int count = 0;
+  char *c = list;
+  while (isdigit((unsigned char)*c)) {
+    unsigned long long first = parse_ull(&c);
+    unsigned long long last = first;
+    unsigned long long used = 1, group = 1;
+    if (*c == '-') {
+      c++;
+      last = parse_ull(&c);
+      if (*c == ':') {
+        c++;
+        used = parse_ull(&c);
+        if (*c++ != '/' || (group = parse_ull(&c)) == 0 || used > group) {
+          break;
+        }
+      }
+    }
+    for (unsigned long long cpu = first; cpu <= last && cpu < (unsigned)nbits;
+         cpu++) {
+      if ((cpu - first) % group < used && !CPUSET_ISSET(set, cpu)) {
+        CPUSET_SET(set, cpu);
+        count++;
+      }
+    }
+    if (*c != ',') {
+      break;
+    }
+    c++;
+  }
+  return count;
+}
+
+/*
+    /proc/meminfo
+*/
+
+#if defined(__linux__) || defined(__NetBSD__)
+// picks every field tinyfetch uses out of a meminfo buffer in a single pass.
+// sizes are in kB, HugePages_* are page counts, absent fields are -1.
+void meminfo_parse(char *buf, struct tinymeminfo *mi) {
+  const struct {
+    const char *key;
+    long long *value;
+  } fields[] = {
+      {"MemTotal:", &mi->mem_total},
+      {"MemFree:", &mi->mem_free},
+      {"MemAvailable:", &mi->mem_available},
+      {"SwapTotal:", &mi->swap_total},
+      {"SwapFree:", &mi->swap_free},
+      {"AnonHugePages:", &mi->anon_hugepages},
+      {"HugePages_Total:", &mi->hugepages_total},
+      {"HugePages_Free:", &mi->hugepages_free},
+      {"Hugepagesize:", &mi->hugepagesize},
+  };
+  int num_fields = sizeof(fields) / sizeof(fields[0]);
+  for (int i = 0; i < num_fields; i++) {
+    *fields[i].value = -1;
+  }
+
+  for (char *line = buf; line != NULL && *line != '\0';) {
+    for (int i = 0; i < num_fields; i++) {
+      size_t len = strlen(fields[i].key);
+      if (!strncmp(line, fields[i].key, len)) {
+        char *value = line + len;
+        *fields[i].value = parse_ull(&value);
+        break;
+      }
+    }
+    line = strchr(line, '\n');
+    if (line != NULL) {
+      line++;
+    }
+  }
+}
+
+int meminfo_read(struct tinymeminfo *mi) {
+  char buf[8192];
+  if (file_read_at(AT_FDCWD, "/proc/meminfo", buf, sizeof(buf)) <= 0) {
+    return -1;
+  }
+  meminfo_parse(buf, mi);
+  return 0;
+}
+#endif
+
 /*
     hostname handling
 */
@@ -145,6 +469,83 @@ char *get_hostname(void) {
   }
 }
 
+/*
+    user identity
+*/
+
+#if ENABLE_USER
+// looks the uid up in the local passwd file only. going through getpwuid()
+// would let NSS reach out to SSSD/LDAP, which is what we're avoiding.
+char *passwd_name(uid_t uid) {
+  FILE *passwd = fopen("/etc/passwd", "r");
+  if (passwd == NULL) {
+    return NULL;
+  }
+
+  char line[512];
+  while (fgets(line, sizeof(line), passwd)) {
+    char *name_end = strchr(line, ':');
+    char *uid_field = (name_end != NULL) ? strchr(name_end + 1, ':') : NULL;
+    if (uid_field == NULL || !isdigit((unsigned char)uid_field[1])) {
+      continue;
+    }
+    if ((uid_t)strtoul(uid_field + 1, NULL, 10) == uid) {
+      fclose(passwd);
+      *name_end = '\0';
+      return strdup(line);
+    }
+  }
+
+  fclose(passwd);
+  return NULL;
+}
+
+char *resolve_username(void) {
+  // $USER, then $LOGNAME, then the audit login uid, then the real uid.
+  const char *env = getenv("USER");
+  if (env == NULL || env[0] == '\0') {
+    env = getenv("LOGNAME");
+  }
+  if (env != NULL && env[0] != '\0') {
+    return strdup(env);
+  }
+
+  uid_t uid = getuid();
+  char buf[32];
+  if (file_read_at(AT_FDCWD, "/proc/self/loginuid", buf, sizeof(buf)) > 0) {
+    unsigned long loginuid = strtoul(buf, NULL, 10);
+    if (loginuid != 4294967295UL) { // (uid_t)-1 means no login session
+      uid = loginuid;
+    }
+  }
+
+  if (nss_enable == 1) {
+    struct passwd pw, *found = NULL;
+    char pwbuf[1024];
+    if (getpwuid_r(uid, &pw, pwbuf, sizeof(pwbuf), &found) == 0 &&
+        found != NULL) {
+      return strdup(pw.pw_name);
+    }
+  }
+  char *name = passwd_name(uid);
+  if (name != NULL) {
+    return name;
+  }
+
+  snprintf(buf, sizeof(buf), "%lu", (unsigned long)uid);
+  return strdup(buf);
+}
+
+// memoized, so --interval only ever resolves the identity once
+char *get_username(void) {
+  if (username_cache == NULL) {
+    username_cache = resolve_username();
+  }
+  return (username_cache != NULL) ? strdup(username_cache) : NULL;
+}
+
+#endif
+
 /*
     FreeBSD sysctl calling
 */
@@ -182,48 +583,67 @@ char *freebsd_sysctl_str(char *ctlname) {
     shell detection
 */
 
+#if ENABLE_SHELL
 #ifdef __linux__
-char *get_parent_shell(void) {
-  pid_t ppid = getppid(); // get parent proc ID
-  char cmdline_path[64];
-  snprintf(cmdline_path, sizeof(cmdline_path), CMDLINE_PATH, ppid);
-
-  FILE *cmdline_file = fopen(cmdline_path, "r"); // open /proc/%d/cmdline
-  if (cmdline_file == NULL) {
-    return NULL; // return NULL if cmdline_file doesnt exist
+int is_known_shell(const char *name) {
+  int num_shells = sizeof(known_shells) / sizeof(known_shells[0]);
+  for (int i = 0; i < num_shells; i++) {
+    if (!strcmp(name, known_shells[i])) {
+      return 1;
+    }
   }
+  return 0;
+}
 
-  char cmdline[1024]; // was 256
-  if (fgets(cmdline, sizeof(cmdline), cmdline_file) ==
-      NULL) { // if something bad happened, free memory and return nullptr
-    fclose(cmdline_file);
-    return NULL;
+// one bounded read of /proc/<pid>/stat: copies comm into name and returns the
+// parent pid, or -1 if the process is gone.
+pid_t proc_stat_parent(pid_t pid, char *name, size_t size) {
+  char stat_path[64];
+  char stat[512]; // comm and ppid are always within the first few fields
+  snprintf(stat_path, sizeof(stat_path), STAT_PATH, pid);
+  if (file_read_at(AT_FDCWD, stat_path, stat, sizeof(stat)) <= 0) {
+    return -1;
   }
 
-  fclose(cmdline_file); // close the file
-
-  cmdline[strcspn(cmdline, "\n")] = '\0';
-
-  if (cmdline[0] == '-') { // NOTE: this fixes a bug that occurs sometimes
-                           // either when using tmux or Konsole.
-    memmove(cmdline, cmdline + 1, strlen(cmdline));
+  // comm may itself contain spaces and parens, so take the last ')'
+  char *comm_start = strchr(stat, '(');
+  char *comm_end = strrchr(stat, ')');
+  if (comm_start == NULL || comm_end == NULL || comm_end < comm_start ||
+      strlen(comm_end) < 5) {
+    return -1;
   }
-
-  char *newline_pos =
-      strchr(cmdline, '\n'); // seek newline, if its there, remove it.
-  if (newline_pos != NULL) {
-    *newline_pos = '\0';
+  size_t len = comm_end - comm_start - 1;
+  if (len >= size) {
+    len = size - 1;
   }
+  memcpy(name, comm_start + 1, len);
+  name[len] = '\0';
 
-  if (!strncmp(cmdline, "/bin/", 5) ||
-      !strncmp(cmdline, "/usr/local/bin", 15)) {
-    return strdup(cmdline + ((cmdline[1] == 'u') ? 15 : 5));
-  }
-  if (!strncmp(cmdline, "/usr/bin/", 9)) {
-    return strdup(cmdline + 9);
+  return (pid_t)strtol(comm_end + 4, NULL, 10); // skip ") S "
+}
+
+char *get_parent_shell(void) {
+  // walk up through sudo, tmux, script, env and friends until something that
+  // looks like a shell shows up. if nothing does, report the direct parent.
+  char name[64];
+  char parent_name[64] = "";
+  pid_t pid = getppid();
+  for (int depth = 0; depth < SHELL_SEARCH_DEPTH && pid > 0; depth++) {
+    pid_t ppid = proc_stat_parent(pid, name, sizeof(name));
+    if (ppid < 0) {
+      break;
+    }
+    char *shell = (name[0] == '-') ? name + 1 : name; // login shells
+    if (is_known_shell(shell)) {
+      return strdup(shell);
+    }
+    if (depth == 0) {
+      memcpy(parent_name, shell, strlen(shell) + 1);
+    }
+    pid = ppid;
   }
 
-  return strdup(cmdline); // return the contents of cmdline
+  return (parent_name[0] != '\0') ? strdup(parent_name) : NULL;
 }
 #endif
 #if defined(__FreeBSD__) || defined(__MacOS__) || defined(__NetBSD__)
@@ -252,6 +672,9 @@ char *get_parent_shell_noproc(void) {
 }
 #endif
 
+#endif
+
+#if ENABLE_UPTIME || ENABLE_PROMETHEUS
 #ifdef __linux__
 long int get_uptime(void) {
   struct sysinfo s_info; // define struct for sysinfo
@@ -322,6 +745,8 @@ void format_uptime(long int uptime) {
   printf("\n");
 }
 
+#endif
+
 /*
         GPU detection
 */
@@ -332,12 +757,16 @@ char *get_gpu_name() {
   struct pci_access *pacc;
   struct pci_dev *dev;
   char namebuf[1024], *name;
+  char *result = NULL;
+  int scanned = 0;
+  TINY_PROBE(gpu__entry);
 
   pacc = pci_alloc();
   pci_init(pacc);
   pci_scan_bus(pacc);
 
-  for (dev = pacc->devices; dev; dev = dev->next) {
+  for (dev = pacc->devices; dev && result == NULL; dev = dev->next) {
+    scanned++;
     pci_fill_info(dev, PCI_FILL_IDENT | PCI_FILL_BASES | PCI_FILL_CLASS);
     if ((dev->device_class == PCI_CLASS_DISPLAY_VGA) ||
         (dev->device_class == PCI_CLASS_DISPLAY_3D)) {
@@ -345,67 +774,3257 @@ char *get_gpu_name() {
       name = pci_lookup_name(pacc, namebuf, sizeof(namebuf), PCI_LOOKUP_DEVICE,
                              dev->vendor_id, dev->device_id);
       if (name) {
-        char *result = strdup(name);
-        pci_cleanup(pacc);
-        return result;
+        result = strdup(name);
       }
     }
   }
 
   pci_cleanup(pacc);
-  return NULL;
+  TINY_PROBE1(gpu__return, scanned);
+  return result;
 }
 
 #endif
 #endif
+
 /*
-    main printing functions
+    distro, CPU and memory queries
 */
 
-void pretext(const char *string) {
-  printf("%s", string);
-  fflush(stdout); // flush stdout, just in case.
+// the Distro line: "<name> <version>", shared with --batch and the
+// Prometheus distro label
+void distro_string(char *out, size_t size, const char *name,
+                   const char *version) {
+  snprintf(out, size, "%s%s%s", name != NULL ? name : "Generic Linux",
+           version != NULL ? " " : "", version != NULL ? version : "");
 }
 
-void fetchinfo(char *structname) { printf("%s\n", structname); }
+// the os-release and cpuinfo parsers behind the Distro and CPU lines, which
+// --batch runs on captured copies
+#if ENABLE_DISTRO || ENABLE_PROMETHEUS || ENABLE_BATCH
+// "KEY=value" or KEY="value" from an os-release file
+int os_release_field(const char *buf, const char *key, char *out,
+                     size_t size) {
+  size_t len = strlen(key);
+  for (const char *line = buf; line != NULL && *line != '\0';) {
+    if (!strncmp(line, key, len) && line[len] == '=') {
+      const char *value = line + len + 1;
+      size_t n = strcspn(value, "\n");
+      if (*value == '"' || *value == '\'') {
+        value++;
+        n = strcspn(value, "\"'\n");
+      }
+      if (n >= size) {
+        n = size - 1;
+      }
+      memcpy(out, value, n);
+      out[n] = '\0';
+      return 0;
+    }
+    line = strchr(line, '\n');
+    if (line != NULL) {
+      line++;
+    }
+  }
+  return -1;
+}
 
-void tinyinit(void) {
-  if (uname(&tiny) == -1) {
-    perror("uname");
+// NAME keeps only its first word ("Debian", not "Debian GNU/Linux")
+int os_release_name(const char *buf, char *out, size_t size) {
+  if (os_release_field(buf, "NAME", out, size) != 0) {
+    return -1;
   }
+  out[strcspn(out, " \t")] = '\0';
+  return 0;
 }
+#endif
 
-unsigned long generate_random_index(unsigned long *seed, int array_size) {
-  // Initialize the seed using /dev/urandom
-  int urandom = open("/dev/urandom", O_RDONLY);
-  if (urandom < 0) {
-    perror("Unable to open /dev/urandom");
-    exit(EXIT_FAILURE);
+#if defined(__linux__) && (ENABLE_CPU || ENABLE_PROMETHEUS || ENABLE_BATCH)
+// the model string ("model name", or "cpu" on POWER) and the number of
+// "processor" entries
+int cpuinfo_parse(const char *buf, char *model, size_t size) {
+  int count = 0;
+  model[0] = '\0';
+  for (const char *line = buf; line != NULL && *line != '\0';) {
+    if (!strncmp(line, "processor", 9)) {
+      count++;
+    } else if (model[0] == '\0' &&
+               (!strncmp(line, "model name", 10) ||
+                (!strncmp(line, "cpu", 3) &&
+                 line[3 + strspn(line + 3, " \t")] == ':'))) {
+      const char *value = strchr(line, ':');
+      if (value != NULL && value < line + strcspn(line, "\n")) {
+        value += 1 + strspn(value + 1, " \t");
+        size_t n = strcspn(value, "\n");
+        if (n >= size) {
+          n = size - 1;
+        }
+        memcpy(model, value, n);
+        model[n] = '\0';
+      }
+    }
+    line = strchr(line, '\n');
+    if (line != NULL) {
+      line++;
+    }
   }
-  if (read(urandom, seed, sizeof(*seed)) < 0) {
-    perror("Unable to read from /dev/urandom");
-    close(urandom);
-    exit(EXIT_FAILURE);
+  return count;
+}
+#endif
+
+#if ENABLE_DISTRO || ENABLE_PROMETHEUS
+char *get_distro_name(void) {
+#ifdef __NetBSD__
+  return strdup("NetBSD");
+#else
+  char buf[4096], name[256];
+  if (file_read_at(AT_FDCWD, "/etc/os-release", buf, sizeof(buf)) <= 0 ||
+      os_release_name(buf, name, sizeof(name)) != 0) {
+    return NULL;
   }
-  close(urandom);
+  return strdup(name);
+#endif
+}
 
-  // Generate a random number using the LCG
-  *seed = (MULTIPLIER * (*seed) + INCREMENT) % MODULUS;
+char *get_distro_version(void) {
+#ifdef __NetBSD__
+  return NULL;
+#else
+  char buf[4096], version[256];
+  if (file_read_at(AT_FDCWD, "/etc/os-release", buf, sizeof(buf)) <= 0 ||
+      os_release_field(buf, "VERSION_ID", version, sizeof(version)) != 0) {
+    return NULL;
+  }
+  return strdup(version);
+#endif
+}
 
-  // Return a random index within the array size
-  return *seed % array_size;
+#endif
+
+#if ENABLE_CPU || ENABLE_PROMETHEUS
+char *get_cpu_model(void) {
+#ifdef __linux__
+  // the model is in the first record, one read() is enough even on
+  // machines whose cpuinfo runs to megabytes
+  char buf[4096], model[256];
+  if (file_read_at(AT_FDCWD, "/proc/cpuinfo", buf, sizeof(buf)) <= 0) {
+    return NULL;
+  }
+  cpuinfo_parse(buf, model, sizeof(model));
+  return (model[0] != '\0') ? strdup(model) : NULL;
+#endif
+#if defined(__FreeBSD__) || defined(__MacOS__) || defined(__NetBSD__)
+#ifdef __NetBSD__
+  char *cpu = freebsd_sysctl_str("machdep.cpu_brand");
+  if (cpu == NULL)
+    cpu = freebsd_sysctl_str("hw.model");
+#else
+  char *cpu = freebsd_sysctl_str("hw.model");
+#endif
+  if (cpu != NULL)
+    trim_spaces(cpu);
+  return cpu;
+#endif
 }
 
-void rand_string(void) {
-  if (rand_enable == 1) {
-    int num_strings = sizeof(strings) / sizeof(strings[0]);
-    unsigned long seed;
-    unsigned long n = generate_random_index(&seed, num_strings);
-    fflush(stdout);
-    printf("%s %s\n", decoration, strings[n]);
+#endif
+
+#if ENABLE_PROMETHEUS
+// total and available RAM in bytes
+int get_ram_stats(long long *total, long long *avail) {
+#if defined(__linux__) || defined(__NetBSD__)
+  struct tinymeminfo mi;
+  if (meminfo_read(&mi) != 0) {
+    return -1;
+  }
+  long long ram_free =
+      (mi.mem_available != -1) ? mi.mem_available : mi.mem_free;
+  if (mi.mem_total == -1 || ram_free == -1) {
+    return -1;
   }
+  (*total) = mi.mem_total * 1024;
+  (*avail) = ram_free * 1024;
+#endif
+#if defined(__FreeBSD__) || defined(__MacOS__)
+  size_t total_ram_bytes;
+  freebsd_sysctl("hw.physmem", total_ram_bytes);
+  size_t cached_pages;
+  freebsd_sysctl("vm.stats.vm.v_cache_count", cached_pages);
+  size_t inactive_pages;
+  freebsd_sysctl("vm.stats.vm.v_inactive_count", inactive_pages);
+  size_t free_pages;
+  freebsd_sysctl("vm.stats.vm.v_free_count", free_pages);
+  (*total) = total_ram_bytes;
+  (*avail) =
+      (cached_pages + inactive_pages + free_pages) * sysconf(_SC_PAGESIZE);
+#endif
+  return 0;
+}
+#endif
+
+/*
+    CPU utilization
+*/
+
+#if ENABLE_CPU_USAGE && defined(__linux__)
+int cpu_stat_alloc(struct cpu_stat *st, int cap) {
+  // one block, carved into a column per counter
+  unsigned long long *block = calloc((size_t)cap * 5, sizeof(*block));
+  st->id = calloc(cap, sizeof(*st->id));
+  if (block == NULL || st->id == NULL) {
+    free(block);
+    free(st->id);
+    return -1;
+  }
+  st->user = block;
+  st->system = block + cap;
+  st->idle = block + cap * 2;
+  st->iowait = block + cap * 3;
+  st->steal = block + cap * 4;
+  st->cap = cap;
+  st->ncpu = 0;
+  return 0;
+}
+
+void cpu_stat_free(struct cpu_stat *st) {
+  free(st->user);
+  free(st->id);
+}
+
+// one pread() of /proc/stat; only the per-CPU "cpuN" lines are kept.
+int cpu_stat_read(int fd, char *buf, size_t size, struct cpu_stat *st) {
+  ssize_t n = pread(fd, buf, size - 1, 0);
+  if (n <= 0) {
+    return -1;
+  }
+  buf[n] = '\0';
+
+  st->ncpu = 0;
+  char *line = buf;
+  char *end = buf + n;
+  while (line < end && !strncmp(line, "cpu", 3)) {
+    char *eol = memchr(line, '\n', end - line);
+    if (eol == NULL) {
+      break; // truncated, the buffer is sized so this doesn't happen
+    }
+    if (isdigit((unsigned char)line[3]) && st->ncpu < st->cap) {
+      int i = st->ncpu++;
+      char *c = line + 3;
+      // user nice system idle iowait irq softirq steal (guest is in user)
+      st->id[i] = (int)parse_ull(&c);
+      st->user[i] = parse_ull(&c);
+      st->user[i] += parse_ull(&c);
+      st->system[i] = parse_ull(&c);
+      st->idle[i] = parse_ull(&c);
+      st->iowait[i] = parse_ull(&c);
+      st->system[i] += parse_ull(&c);
+      st->system[i] += parse_ull(&c);
+      st->steal[i] = parse_ull(&c);
+    }
+    line = eol + 1;
+  }
+  return 0;
 }
 
+// iowait can go backwards, and idle too across CPU hotplug
+unsigned long long cpu_delta(unsigned long long a, unsigned long long b) {
+  return (b > a) ? b - a : 0;
+}
+
+// usage between two samples with the same CPUs; busy_pct holds ncpu floats
+void cpu_usage_delta(const struct cpu_stat *a, const struct cpu_stat *b,
+                     float *busy_pct, struct cpu_usage *usage) {
+  // straight-line column arithmetic, so the compiler can vectorize it
+  int n = a->ncpu;
+  unsigned long long sum_busy = 0, sum_total = 0, sum_steal = 0;
+  for (int i = 0; i < n; i++) {
+    unsigned long long steal = cpu_delta(a->steal[i], b->steal[i]);
+    unsigned long long busy = cpu_delta(a->user[i], b->user[i]) +
+                              cpu_delta(a->system[i], b->system[i]) + steal;
+    unsigned long long total = busy + cpu_delta(a->idle[i], b->idle[i]) +
+                               cpu_delta(a->iowait[i], b->iowait[i]);
+    busy_pct[i] = total ? 100.0f * busy / total : 0.0f;
+    sum_busy += busy;
+    sum_total += total;
+    sum_steal += steal;
+  }
+  int busiest = 0;
+  for (int i = 1; i < n; i++) {
+    if (busy_pct[i] > busy_pct[busiest]) {
+      busiest = i;
+    }
+  }
+
+  usage->total_pct = sum_total ? 100.0 * sum_busy / sum_total : 0.0;
+  usage->steal_pct = sum_total ? 100.0 * sum_steal / sum_total : 0.0;
+  usage->busiest_cpu = b->id[busiest];
+  usage->busiest_pct = busy_pct[busiest];
+}
+
+int get_cpu_usage(int interval_ms, struct cpu_usage *usage) {
+  int fd = open("/proc/stat", O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return -1;
+  }
+
+  // a cpuN line is at most ~11 20-digit columns
+  int cap = sysconf(_SC_NPROCESSORS_CONF);
+  if (cap < 1) {
+    cap = 1;
+  }
+  size_t size = (size_t)(cap + 2) * 256;
+  char *buf = malloc(size);
+  struct cpu_stat a, b;
+  float *busy_pct = calloc(cap, sizeof(*busy_pct));
+  int ret = -1;
+  if (buf == NULL || busy_pct == NULL || cpu_stat_alloc(&a, cap) != 0) {
+    goto out_buf;
+  }
+  if (cpu_stat_alloc(&b, cap) != 0) {
+    goto out_a;
+  }
+
+  struct timespec delay = {interval_ms / 1000, (interval_ms % 1000) * 1000000L};
+  if (cpu_stat_read(fd, buf, size, &a) != 0 || nanosleep(&delay, NULL) != 0 ||
+      cpu_stat_read(fd, buf, size, &b) != 0 || a.ncpu != b.ncpu ||
+      a.ncpu == 0) {
+    goto out_b;
+  }
+
+  cpu_usage_delta(&a, &b, busy_pct, usage);
+  ret = 0;
+
+out_b:
+  cpu_stat_free(&b);
+out_a:
+  cpu_stat_free(&a);
+out_buf:
+  free(busy_pct);
+  free(buf);
+  close(fd);
+  return ret;
+}
+#endif
+
+/*
+    NUMA topology
+*/
+
+#if ENABLE_NUMA && defined(__linux__)
+int compare_int(const void *a, const void *b) {
+  return *(const int *)a - *(const int *)b;
+}
+
+// MemTotal/MemFree of one nodeN/meminfo, in kB
+int numa_node_meminfo(int nodefd, int node, unsigned long long *total,
+                      unsigned long long *free_kb) {
+  char path[64];
+  char meminfo[4096]; // the totals are on the first lines
+  snprintf(path, sizeof(path), "node%d/meminfo", node);
+  if (file_read_at(nodefd, path, meminfo, sizeof(meminfo)) <= 0) {
+    return -1;
+  }
+  char *total_field = strstr(meminfo, "MemTotal:");
+  char *free_field = strstr(meminfo, "MemFree:");
+  if (total_field == NULL || free_field == NULL) {
+    return -1;
+  }
+  total_field += 9;
+  free_field += 8;
+  (*total) = parse_ull(&total_field);
+  (*free_kb) = parse_ull(&free_field);
+  return 0;
+}
+
+void tinynuma(void) {
+  int nodefd = open("/sys/devices/system/node",
+                    O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (nodefd < 0) {
+    return; // kernel built without NUMA
+  }
+  DIR *dir = fdopendir(nodefd);
+  if (dir == NULL) {
+    close(nodefd);
+    return;
+  }
+
+  int nodes[NUMA_MAX_NODES];
+  int num_nodes = 0;
+  struct dirent *entry;
+  while ((entry = readdir(dir)) != NULL && num_nodes < NUMA_MAX_NODES) {
+    if (!strncmp(entry->d_name, "node", 4) && isdigit((unsigned char)entry->d_name[4])) {
+      nodes[num_nodes++] = atoi(entry->d_name + 4);
+    }
+  }
+
+  if (num_nodes == 0) {
+    closedir(dir); // sysfs without node directories, nothing to report
+    return;
+  }
+  pretext(pretext_numa);
+  if (num_nodes == 1) {
+    // nothing to balance, don't bother reading anything else
+    printf("1 node\n");
+    closedir(dir);
+    return;
+  }
+
+  qsort(nodes, num_nodes, sizeof(nodes[0]), compare_int);
+  printf("%d nodes", num_nodes);
+  for (int i = 0; i < num_nodes; i++) {
+    char path[64];
+    char cpulist[256];
+    unsigned long long total, free_kb;
+    snprintf(path, sizeof(path), "node%d/cpulist", nodes[i]);
+    if (file_read_at(nodefd, path, cpulist, sizeof(cpulist)) <= 0) {
+      cpulist[0] = '\0';
+    }
+    cpulist[strcspn(cpulist, "\n")] = '\0';
+    printf(", node%d", nodes[i]);
+    if (numa_node_meminfo(nodefd, nodes[i], &total, &free_kb) == 0) {
+      printf(" %.1f/%.1f GiB free", free_kb / 1048576.0, total / 1048576.0);
+    }
+    printf(" (cpus %s)", cpulist[0] != '\0' ? cpulist : "none");
+  }
+  printf("\n");
+  closedir(dir); // also closes nodefd
+}
+#endif
+
+/*
+    CPU topology and caches
+*/
+
+#if ENABLE_TOPOLOGY && defined(__linux__)
+// reads one sibling list for cpu and folds it into seen. returns its size.
+int topology_group(int cpufd, int cpu, const char *file, const char *fallback,
+                   unsigned long long *seen) {
+  char path[96];
+  char list[4096];
+  unsigned long long group[CPUSET_WORDS] = {0};
+  snprintf(path, sizeof(path), "cpu%d/topology/%s", cpu, file);
+  ssize_t n = file_read_at(cpufd, path, list, sizeof(list));
+  if (n <= 0 && fallback != NULL) {
+    snprintf(path, sizeof(path), "cpu%d/topology/%s", cpu, fallback);
+    n = file_read_at(cpufd, path, list, sizeof(list));
+  }
+  int count = (n > 0) ? cpulist_parse(list, group, CPUSET_BITS) : 0;
+  if (count == 0) {
+    CPUSET_SET(group, cpu);
+    count = 1;
+  }
+  for (int i = 0; i < CPUSET_WORDS; i++) {
+    seen[i] |= group[i];
+  }
+  return count;
+}
+
+void print_cache_size(const char *size) {
+  char *c = (char *)size;
+  unsigned long long kb = parse_ull(&c);
+  if (kb >= 1024) {
+    printf("%gM", kb / 1024.0);
+  } else {
+    printf("%lluK", kb);
+  }
+}
+
+// the Topology line for a /sys/devices/system/cpu style directory
+void topology_line(int cpufd) {
+  char buf[4096];
+  if (file_read_at(cpufd, "online", buf, sizeof(buf)) <= 0) {
+    return;
+  }
+
+  // every CPU in an already-seen sibling list is skipped, so only one CPU
+  // per core (and one per package) is ever read.
+  unsigned long long online[CPUSET_WORDS] = {0};
+  unsigned long long seen_core[CPUSET_WORDS] = {0};
+  unsigned long long seen_package[CPUSET_WORDS] = {0};
+  int threads = cpulist_parse(buf, online, CPUSET_BITS);
+  int cores = 0, sockets = 0, max_smt = 1;
+  for (int word = 0; word < CPUSET_WORDS; word++) {
+    unsigned long long todo = online[word] & ~seen_core[word];
+    while (todo != 0) {
+      int cpu = word * 64 + __builtin_ctzll(todo);
+      int smt = topology_group(cpufd, cpu, "thread_siblings_list", NULL,
+                               seen_core);
+      cores++;
+      if (smt > max_smt) {
+        max_smt = smt;
+      }
+      if (!CPUSET_ISSET(seen_package, cpu)) {
+        topology_group(cpufd, cpu, "package_cpus_list", "core_siblings_list",
+                       seen_package);
+        sockets++;
+      }
+      todo = online[word] & ~seen_core[word];
+    }
+  }
+
+  pretext(pretext_topology);
+  if (sockets > 1) {
+    printf("%d sockets, %d cores each (%d total)", sockets, cores / sockets,
+           cores);
+  } else {
+    printf("1 socket, %d core%s", cores, cores > 1 ? "s" : "");
+  }
+  printf(", %d thread%s", threads, threads > 1 ? "s" : "");
+  // the kernel says on, off, forceoff, notsupported or notimplemented
+  const char *smt = (max_smt > 1) ? "on" : "off";
+  if (file_read_at(cpufd, "smt/control", buf, sizeof(buf)) > 0) {
+    if (!strncmp(buf, "off", 3) || !strncmp(buf, "forceoff", 8)) {
+      smt = "off";
+    } else if (!strncmp(buf, "not", 3)) {
+      smt = "unsupported";
+    } else if (!strncmp(buf, "on", 2)) {
+      smt = "on";
+    }
+  }
+  printf(" (SMT %s", smt);
+  if (max_smt > 1) {
+    printf(", %d/core)", max_smt);
+  } else {
+    printf(")");
+  }
+
+  for (int index = 0;; index++) {
+    char path[96];
+    char level[16], type[32], size[32];
+    snprintf(path, sizeof(path), "cpu0/cache/index%d/level", index);
+    if (file_read_at(cpufd, path, level, sizeof(level)) <= 0) {
+      break;
+    }
+    snprintf(path, sizeof(path), "cpu0/cache/index%d/type", index);
+    if (file_read_at(cpufd, path, type, sizeof(type)) <= 0) {
+      type[0] = '\0';
+    }
+    snprintf(path, sizeof(path), "cpu0/cache/index%d/size", index);
+    if (file_read_at(cpufd, path, size, sizeof(size)) <= 0) {
+      continue;
+    }
+    printf(", L%d%s ", atoi(level),
+           !strncmp(type, "Data", 4)          ? "d"
+           : !strncmp(type, "Instruction", 11) ? "i"
+                                               : "");
+    print_cache_size(size);
+
+    unsigned long long shared[CPUSET_WORDS] = {0};
+    snprintf(path, sizeof(path), "cpu0/cache/index%d/shared_cpu_list", index);
+    if (file_read_at(cpufd, path, buf, sizeof(buf)) > 0) {
+      int sharing = cpulist_parse(buf, shared, CPUSET_BITS);
+      if (sharing > 1) {
+        printf(" (shared by %d)", sharing);
+      }
+    }
+  }
+  printf("\n");
+}
+
+void tinytopology(void) {
+  int cpufd =
+      open("/sys/devices/system/cpu", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (cpufd < 0) {
+    return;
+  }
+  topology_line(cpufd);
+  close(cpufd);
+}
+#endif
+
+/*
+    ISA extensions
+*/
+
+#if ENABLE_ISA && (defined(__x86_64__) || defined(__i386__))
+unsigned long long read_xcr0(void) {
+  unsigned int eax, edx;
+  __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+  return ((unsigned long long)edx << 32) | eax;
+}
+
+void tinyisa(void) {
+  unsigned int eax, ebx, ecx, edx;
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+    return;
+  }
+  unsigned int ecx1 = ecx;
+  unsigned int ebx7 = 0, ecx7 = 0, edx7 = 0;
+  if (__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+    ebx7 = ebx;
+    ecx7 = ecx;
+    edx7 = edx;
+  }
+
+  // the CPU supporting AVX isn't enough, the kernel has to save the state
+  unsigned long long xcr0 = (ecx1 & bit_OSXSAVE) ? read_xcr0() : 0;
+  int avx_os = (xcr0 & 0x6) == 0x6;                // XMM | YMM
+  int avx512_os = avx_os && (xcr0 & 0xe0) == 0xe0; // opmask | ZMM
+  int amx_os = (xcr0 & 0x60000) == 0x60000;        // XTILECFG | XTILEDATA
+
+  int sse42 = (ecx1 & bit_SSE4_2) && (ecx1 & bit_POPCNT);
+  int avx = avx_os && (ecx1 & bit_AVX);
+  int avx2 = avx && (ebx7 & bit_AVX2) && (ebx7 & bit_BMI2) && (ecx1 & bit_FMA);
+  int avx512 = avx512_os && (ebx7 & bit_AVX512F) && (ebx7 & bit_AVX512BW) &&
+               (ebx7 & bit_AVX512DQ) && (ebx7 & bit_AVX512VL);
+
+  pretext(pretext_isa);
+  // x86-64 psABI microarchitecture levels
+  printf("x86-64-v%d", avx512 ? 4 : avx2 ? 3 : sse42 ? 2 : 1);
+  printf(" (%s)", avx512 ? "AVX-512"
+                  : avx2 ? "AVX2"
+                  : avx  ? "AVX"
+                  : sse42 ? "SSE4.2"
+                          : "SSE2");
+  if (avx512 && (ecx7 & (1u << 11))) {
+    printf(", AVX512-VNNI");
+  }
+  if (amx_os && (edx7 & (1u << 24))) {
+    printf(", AMX");
+  }
+  if (ebx7 & (1u << 29)) {
+    printf(", SHA");
+  }
+  if (ecx1 & (1u << 25)) {
+    printf(", AES-NI");
+  }
+  if (avx && (ecx7 & (1u << 9))) {
+    printf(", VAES");
+  }
+  if (ecx7 & (1u << 8)) {
+    printf(", GFNI");
+  }
+  printf("\n");
+}
+#endif
+#if ENABLE_ISA && defined(__aarch64__) && defined(__linux__)
+void tinyisa(void) {
+  unsigned long hwcap = getauxval(AT_HWCAP);
+  unsigned long hwcap2 = getauxval(AT_HWCAP2);
+  (void)hwcap2;
+
+  pretext(pretext_isa);
+  printf("ARMv8");
+  if (hwcap & HWCAP_ASIMD) {
+    printf(" (NEON");
+#ifdef HWCAP_SVE
+    if (hwcap & HWCAP_SVE) {
+      printf(", SVE");
+    }
+#endif
+#ifdef HWCAP2_SVE2
+    if (hwcap2 & HWCAP2_SVE2) {
+      printf(", SVE2");
+    }
+#endif
+#ifdef HWCAP2_SME
+    if (hwcap2 & HWCAP2_SME) {
+      printf(", SME");
+    }
+#endif
+    printf(")");
+  }
+  if (hwcap & HWCAP_AES) {
+    printf(", AES");
+  }
+  if (hwcap & HWCAP_SHA2) {
+    printf(", SHA2");
+  }
+#ifdef HWCAP_SHA512
+  if (hwcap & HWCAP_SHA512) {
+    printf(", SHA512");
+  }
+#endif
+  if (hwcap & HWCAP_ATOMICS) {
+    printf(", LSE");
+  }
+  printf("\n");
+}
+#endif
+
+/*
+    hugepages
+*/
+
+#if ENABLE_HUGEPAGES && defined(__linux__)
+// THP sysfs files list every mode with the active one in brackets
+int thp_mode(const char *path, char *mode, size_t size) {
+  char buf[128];
+  if (file_read_at(AT_FDCWD, path, buf, sizeof(buf)) <= 0) {
+    return -1;
+  }
+  char *start = strchr(buf, '[');
+  char *end = (start != NULL) ? strchr(start, ']') : NULL;
+  if (end == NULL || (size_t)(end - start) > size) {
+    return -1;
+  }
+  memcpy(mode, start + 1, end - start - 1);
+  mode[end - start - 1] = '\0';
+  return 0;
+}
+
+void print_size_kb(long long kb) {
+  if (kb >= 1048576) {
+    printf("%g GiB", kb / 1048576.0);
+  } else if (kb >= 1024) {
+    printf("%g MiB", kb / 1024.0);
+  } else {
+    printf("%lld KiB", kb);
+  }
+}
+
+void tinyhugepages(void) {
+  struct tinymeminfo mi;
+  if (meminfo_read(&mi) != 0) {
+    return;
+  }
+  char enabled[32], defrag[32];
+  int thp = thp_mode("/sys/kernel/mm/transparent_hugepage/enabled", enabled,
+                     sizeof(enabled)) == 0;
+
+  pretext(pretext_hugepages);
+  if (thp) {
+    printf("THP %s", enabled);
+    if (thp_mode("/sys/kernel/mm/transparent_hugepage/defrag", defrag,
+                 sizeof(defrag)) == 0) {
+      printf(" (defrag %s", defrag);
+      if (mi.anon_hugepages > 0) {
+        printf(", ");
+        print_size_kb(mi.anon_hugepages);
+        printf(" in use");
+      }
+      printf(")");
+    }
+  } else {
+    printf("THP unavailable");
+  }
+  if (mi.hugepages_total > 0) {
+    printf(", hugetlb %lld/%lld free x ", mi.hugepages_free,
+           mi.hugepages_total);
+    print_size_kb(mi.hugepagesize);
+  } else {
+    printf(", no hugetlb pool");
+  }
+  printf("\n");
+}
+#endif
+
+/*
+    pressure stall information
+*/
+
+#if ENABLE_PRESSURE && defined(__linux__)
+// pulls avg10 out of the "some" and "full" lines of a /proc/pressure file as
+// hundredths of a percent; the kernel always prints exactly two decimals.
+int psi_parse(char *buf, int *some, int *full) {
+  *some = *full = -1;
+  for (char *line = buf; line != NULL && *line != '\0';) {
+    int *target = !strncmp(line, "some ", 5)   ? some
+                  : !strncmp(line, "full ", 5) ? full
+                                               : NULL;
+    char *avg = (target != NULL) ? strstr(line, "avg10=") : NULL;
+    if (avg != NULL) {
+      avg += 6;
+      int value = parse_ull(&avg) * 100;
+      if (*avg == '.' && isdigit((unsigned char)avg[1]) &&
+          isdigit((unsigned char)avg[2])) {
+        value += (avg[1] - '0') * 10 + (avg[2] - '0');
+      }
+      *target = value;
+    }
+    line = strchr(line, '\n');
+    if (line != NULL) {
+      line++;
+    }
+  }
+  return (*some == -1) ? -1 : 0;
+}
+
+void tinypressure(void) {
+  const char *resources[] = {"cpu", "memory", "io"};
+  int some[3], full[3];
+  int dirfd = open("/proc/pressure", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (dirfd < 0) {
+    return; // kernel built without CONFIG_PSI
+  }
+  for (int i = 0; i < 3; i++) {
+    char buf[256];
+    if (file_read_at(dirfd, resources[i], buf, sizeof(buf)) <= 0 ||
+        psi_parse(buf, &some[i], &full[i]) != 0) {
+      close(dirfd);
+      return; // also the case when booted with psi=0
+    }
+  }
+  close(dirfd);
+
+  pretext(pretext_pressure);
+  for (int i = 0; i < 3; i++) {
+    printf("%s%s %d.%02d%%", (i > 0) ? ", " : "", resources[i], some[i] / 100,
+           some[i] % 100);
+    if (full[i] > 0) {
+      printf(" (full %d.%02d%%)", full[i] / 100, full[i] % 100);
+    }
+  }
+  printf("\n");
+}
+#endif
+
+/*
+    cgroup v2 limits
+*/
+
+#if ENABLE_CGROUP && defined(__linux__)
+// "max" means unlimited and comes back as -1
+long long cgroup_value(char **p) {
+  while (**p == ' ') {
+    (*p)++;
+  }
+  if (!strncmp(*p, "max", 3)) {
+    *p += 3;
+    return -1;
+  }
+  return parse_ull(p);
+}
+
+// opens the v2 cgroup named in self (a /proc/<pid>/cgroup) under root, on a
+// pure v2 mount or the unified hierarchy of a hybrid setup
+int cgroup_open(const char *self, const char *root) {
+  char buf[4096];
+  if (file_read_at(AT_FDCWD, self, buf, sizeof(buf)) <= 0) {
+    return -1;
+  }
+  char *path = (!strncmp(buf, "0::", 3)) ? buf : strstr(buf, "\n0::");
+  if (path == NULL) {
+    return -1; // v1 only
+  }
+  path += (*path == '\n') ? 4 : 3;
+  path[strcspn(path, "\n")] = '\0';
+  while (*path == '/') {
+    path++;
+  }
+  if (*path == '\0') {
+    path = ".";
+  }
+
+  char unified[PATH_MAX];
+  snprintf(unified, sizeof(unified), "%s/unified", root);
+  const char *roots[] = {root, unified};
+  for (int i = 0; i < 2; i++) {
+    int rootfd = open(roots[i], O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (rootfd < 0) {
+      continue;
+    }
+    int fd = -1;
+    if (faccessat(rootfd, "cgroup.controllers", F_OK, 0) == 0) {
+      fd = openat(rootfd, path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    }
+    close(rootfd);
+    if (fd >= 0) {
+      return fd;
+    }
+  }
+  return -1;
+}
+
+int cgroup_read(const char *self, const char *root, struct tinycgroup *cg) {
+  char buf[4096];
+  char *p;
+  cg->mem_max = cg->mem_current = -1;
+  cg->cpu_quota = cg->cpu_period = -1;
+  cg->cpus = -1;
+
+  int fd = cgroup_open(self, root);
+  if (fd < 0) {
+    return -1;
+  }
+  // every file is optional, the root cgroup and disabled controllers lack them
+  if (file_read_at(fd, "memory.max", buf, sizeof(buf)) > 0) {
+    p = buf;
+    cg->mem_max = cgroup_value(&p);
+  }
+  if (file_read_at(fd, "memory.current", buf, sizeof(buf)) > 0) {
+    p = buf;
+    cg->mem_current = cgroup_value(&p);
+  }
+  if (file_read_at(fd, "cpu.max", buf, sizeof(buf)) > 0) {
+    p = buf;
+    cg->cpu_quota = cgroup_value(&p);
+    cg->cpu_period = cgroup_value(&p);
+  }
+  if (file_read_at(fd, "cpuset.cpus.effective", buf, sizeof(buf)) > 0) {
+    unsigned long long set[CPUSET_WORDS] = {0};
+    buf[strcspn(buf, "\n")] = '\0';
+    cg->cpus = cpulist_parse(buf, set, CPUSET_BITS);
+  }
+  close(fd);
+  return 0;
+}
+
+void cgroup_print_size(long long bytes) {
+  double mib = bytes / 1048576.0;
+  if (mib < 1024) {
+    printf("%.2f MiB", mib);
+  } else {
+    printf("%.2f GiB", mib / 1024.0);
+  }
+}
+
+// prints the limits next to the host figures; with only_limited set, a
+// process that is not actually constrained prints nothing
+void cgroup_line(int only_limited) {
+  struct tinycgroup cg;
+  if (cgroup_read(CGROUP_SELF, CGROUP_ROOT, &cg) != 0) {
+    return;
+  }
+  int host_cpus = get_cpu_count();
+  double cpu_limit = -1;
+  if (cg.cpu_quota > 0 && cg.cpu_period > 0) {
+    cpu_limit = (double)cg.cpu_quota / cg.cpu_period;
+  }
+  if (cg.cpus > 0 && cg.cpus < host_cpus &&
+      (cpu_limit < 0 || cg.cpus < cpu_limit)) {
+    cpu_limit = cg.cpus;
+  }
+  if (cpu_limit >= host_cpus) {
+    cpu_limit = -1; // a quota above the machine size limits nothing
+  }
+  if (only_limited && cpu_limit < 0 && cg.mem_max < 0) {
+    return;
+  }
+
+  if (ascii_enable == 1) {
+    printf("%s", tinyascii_p9); // below the art, with swap and the GPU
+  }
+  pretext(pretext_cgroup);
+  if (cpu_limit >= 0) {
+    printf("%.2f of %d CPUs", cpu_limit, host_cpus);
+  } else {
+    printf("all %d CPUs", host_cpus);
+  }
+  if (cg.mem_max >= 0) {
+    printf(", ");
+    if (cg.mem_current >= 0) {
+      cgroup_print_size(cg.mem_current);
+      printf(" used / ");
+    }
+    cgroup_print_size(cg.mem_max);
+    printf(" max");
+    struct tinymeminfo mi;
+    if (meminfo_read(&mi) == 0 && mi.mem_total > 0) {
+      printf(" (host ");
+      cgroup_print_size(mi.mem_total * 1024);
+      printf(")");
+    }
+  } else {
+    printf(", no memory limit");
+  }
+  printf("\n");
+}
+
+void tinycgroup(void) { cgroup_line(0); }
+
+// the full fetch only mentions the cgroup when it limits something
+void tinycgroup_limited(void) { cgroup_line(1); }
+#endif
+
+/*
+    largest processes
+*/
+
+#if ENABLE_TOP && defined(__linux__)
+struct linux_dirent64 { // glibc only exposes getdents64 from 2.30 on
+  unsigned long long d_ino;
+  long long d_off;
+  unsigned short d_reclen;
+  unsigned char d_type;
+  char d_name[];
+};
+
+// min-heap on rss, so the root is the entry the next larger process evicts
+void top_heap_push(struct top_heap *h, int pid, unsigned long long rss) {
+  int i;
+  if (h->len < h->cap) {
+    i = h->len++;
+  } else if (rss > h->entries[0].rss) {
+    i = 0;
+    for (;;) { // sift the new root down
+      int child = 2 * i + 1;
+      if (child >= h->len) {
+        break;
+      }
+      if (child + 1 < h->len &&
+          h->entries[child + 1].rss < h->entries[child].rss) {
+        child++;
+      }
+      if (h->entries[child].rss >= rss) {
+        break;
+      }
+      h->entries[i] = h->entries[child];
+      i = child;
+    }
+    h->entries[i].pid = pid;
+    h->entries[i].rss = rss;
+    return;
+  } else {
+    return;
+  }
+  while (i > 0 && h->entries[(i - 1) / 2].rss > rss) { // sift up
+    h->entries[i] = h->entries[(i - 1) / 2];
+    i = (i - 1) / 2;
+  }
+  h->entries[i].pid = pid;
+  h->entries[i].rss = rss;
+}
+
+// collects every numeric entry of /proc with raw getdents64
+int *top_list_pids(int procfd, int *count) {
+  char buf[32768];
+  int cap = 1024, n = 0;
+  int *pids = malloc(cap * sizeof(int));
+  if (pids == NULL || lseek(procfd, 0, SEEK_SET) != 0) {
+    free(pids);
+    return NULL;
+  }
+  for (;;) {
+    long nread = syscall(SYS_getdents64, procfd, buf, sizeof(buf));
+    if (nread <= 0) {
+      break;
+    }
+    for (long off = 0; off < nread;) {
+      struct linux_dirent64 *d = (struct linux_dirent64 *)(buf + off);
+      off += d->d_reclen;
+      if (d->d_name[0] < '1' || d->d_name[0] > '9') {
+        continue;
+      }
+      if (n == cap) {
+        int new_cap = cap * 2;
+        int *grown = realloc(pids, new_cap * sizeof(int));
+        if (grown == NULL) {
+          free(pids); // a partial list would quietly miss processes
+          return NULL;
+        }
+        pids = grown;
+        cap = new_cap;
+      }
+      pids[n++] = atoi(d->d_name);
+    }
+  }
+  *count = n;
+  return pids;
+}
+
+void *top_scan(void *data) {
+  struct top_scan *scan = data;
+  long page_kb = sysconf(_SC_PAGESIZE) / 1024;
+  for (int i = scan->first; i < scan->last; i++) {
+    char path[32], buf[128];
+    snprintf(path, sizeof(path), "%d/statm", scan->pids[i]);
+    // processes that exit mid-scan fail here with ENOENT and are skipped
+    if (file_read_at(scan->procfd, path, buf, sizeof(buf)) <= 0) {
+      continue;
+    }
+    char *p = buf;
+    parse_ull(&p); // total program size
+    unsigned long long resident = parse_ull(&p);
+    if (resident > 0) { // kernel threads have no user memory
+      top_heap_push(&scan->heap, scan->pids[i], resident * page_kb);
+    }
+  }
+  return NULL;
+}
+
+int compare_top_entry(const void *a, const void *b) {
+  const struct top_entry *x = a, *y = b;
+  return (x->rss < y->rss) - (x->rss > y->rss);
+}
+
+// the Top RSS line for the count largest processes of a /proc style directory
+void top_line(int procfd, int count) {
+  int npids;
+  int *pids = top_list_pids(procfd, &npids);
+  if (pids == NULL) {
+    return;
+  }
+
+  // one thread per TOP_THREAD_PIDS processes, each with its own heap
+  int nthreads = npids / TOP_THREAD_PIDS + 1;
+  int ncpu = get_cpu_count();
+  if (nthreads > ncpu) {
+    nthreads = ncpu;
+  }
+  if (nthreads > TOP_MAX_THREADS) {
+    nthreads = TOP_MAX_THREADS;
+  }
+  if (nthreads < 1) {
+    nthreads = 1;
+  }
+  struct top_scan scans[TOP_MAX_THREADS];
+  pthread_t threads[TOP_MAX_THREADS];
+  struct top_entry *entries = malloc(nthreads * count * sizeof(*entries));
+  if (entries == NULL) {
+    free(pids);
+    return;
+  }
+  for (int t = 0; t < nthreads; t++) {
+    scans[t].procfd = procfd;
+    scans[t].pids = pids;
+    scans[t].first = (long long)npids * t / nthreads;
+    scans[t].last = (long long)npids * (t + 1) / nthreads;
+    scans[t].heap.entries = entries + t * count;
+    scans[t].heap.len = 0;
+    scans[t].heap.cap = count;
+    scans[t].started = t > 0 && pthread_create(&threads[t], NULL, top_scan,
+                                               &scans[t]) == 0;
+    if (t > 0 && !scans[t].started) {
+      top_scan(&scans[t]);
+    }
+  }
+  top_scan(&scans[0]);
+
+  // fold the per-thread heaps into the first one
+  for (int t = 1; t < nthreads; t++) {
+    if (scans[t].started) {
+      pthread_join(threads[t], NULL);
+    }
+    for (int i = 0; i < scans[t].heap.len; i++) {
+      top_heap_push(&scans[0].heap, scans[t].heap.entries[i].pid,
+                    scans[t].heap.entries[i].rss);
+    }
+  }
+  struct top_heap *top = &scans[0].heap;
+  qsort(top->entries, top->len, sizeof(*top->entries), compare_top_entry);
+
+  // names are only looked up for the winners
+  pretext(pretext_top);
+  for (int i = 0; i < top->len; i++) {
+    char path[32], comm[64];
+    snprintf(path, sizeof(path), "%d/comm", top->entries[i].pid);
+    if (file_read_at(procfd, path, comm, sizeof(comm)) <= 0) {
+      strcpy(comm, "?");
+    }
+    comm[strcspn(comm, "\n")] = '\0';
+    double mib = top->entries[i].rss / 1024.0;
+    printf("%s%s (%d) ", (i > 0) ? ", " : "", comm, top->entries[i].pid);
+    if (mib < 1024) {
+      printf("%.1f MiB", mib);
+    } else {
+      printf("%.2f GiB", mib / 1024.0);
+    }
+  }
+  printf("\n");
+
+  free(entries);
+  free(pids);
+}
+
+void tinytop(void) {
+  int procfd = open("/proc", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (procfd < 0) {
+    return;
+  }
+  top_line(procfd, top_count);
+  close(procfd);
+}
+#endif
+
+/*
+    interrupt affinity
+*/
+
+#if ENABLE_IRQ && defined(__linux__)
+// the header names the online CPUs, one column each
+int irq_header(char *line, struct irq_summary *sum) {
+  int n = 0;
+  for (char *c = strstr(line, "CPU"); c != NULL; c = strstr(c, "CPU")) {
+    n++;
+    c += 3;
+  }
+  if (n > sum->cap) {
+    int *id = realloc(sum->cpu_id, n * sizeof(int));
+    if (id == NULL) {
+      return -1;
+    }
+    sum->cpu_id = id;
+    unsigned long long *total =
+        realloc(sum->cpu_total, n * sizeof(unsigned long long));
+    if (total == NULL) {
+      return -1;
+    }
+    sum->cpu_total = total;
+    sum->cap = n;
+  }
+  n = 0;
+  for (char *c = strstr(line, "CPU"); c != NULL; c = strstr(c, "CPU")) {
+    c += 3;
+    sum->cpu_id[n] = parse_ull(&c);
+    sum->cpu_total[n++] = 0;
+  }
+  sum->ncpu = n;
+  return 0;
+}
+
+// one row: "<irq>: <count per cpu> <chip> <hwirq> <name>"; only numbered
+// device interrupts are ranked, the per-CPU arch rows can't be steered
+void irq_row(char *line, struct irq_summary *sum) {
+  char *c = line;
+  while (*c == ' ') {
+    c++;
+  }
+  if (!isdigit((unsigned char)*c)) {
+    return;
+  }
+  parse_ull(&c);
+  if (*c != ':') {
+    return;
+  }
+  c++;
+
+  unsigned long long total = 0, max = 0;
+  int max_col = 0;
+  for (int col = 0; col < sum->ncpu; col++) {
+    while (*c == ' ') {
+      c++;
+    }
+    if (!isdigit((unsigned char)*c)) {
+      break;
+    }
+    unsigned long long count = parse_ull(&c);
+    sum->cpu_total[col] += count;
+    total += count;
+    if (count > max) {
+      max = count;
+      max_col = col;
+    }
+  }
+  sum->device_total += total;
+  if (total == 0) {
+    return;
+  }
+
+  // insert into the short descending top list
+  int pos = (sum->nsources < IRQ_TOP) ? sum->nsources++ : IRQ_TOP;
+  while (pos > 0 && sum->top[pos - 1].total < total) {
+    if (pos < IRQ_TOP) {
+      sum->top[pos] = sum->top[pos - 1];
+    }
+    pos--;
+  }
+  if (pos >= IRQ_TOP) {
+    return;
+  }
+  // the action name is the last field
+  char *end = c + strlen(c);
+  while (end > c && isspace((unsigned char)end[-1])) {
+    end--;
+  }
+  char *name = end;
+  while (name > c && !isspace((unsigned char)name[-1])) {
+    name--;
+  }
+  size_t len = end - name;
+  if (len >= sizeof(sum->top[pos].name)) {
+    len = sizeof(sum->top[pos].name) - 1;
+  }
+  memcpy(sum->top[pos].name, name, len);
+  sum->top[pos].name[len] = '\0';
+  sum->top[pos].total = total;
+  sum->top[pos].max = max;
+  sum->top[pos].max_cpu = sum->cpu_id[max_col];
+}
+
+// streams the file in IRQ_CHUNK reads, carrying a partial last line over to
+// the next read, so the work stays linear however wide the table is
+int irq_summarize(const char *path, struct irq_summary *sum) {
+  static char buf[IRQ_BUF_SIZE];
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return -1;
+  }
+  sum->ncpu = -1;
+  sum->nsources = 0;
+  sum->device_total = 0;
+
+  size_t carry = 0;
+  int skip = 0; // inside a line longer than the whole buffer
+  for (;;) {
+    size_t want = sizeof(buf) - 1 - carry;
+    ssize_t n = read(fd, buf + carry, want < IRQ_CHUNK ? want : IRQ_CHUNK);
+    if (n <= 0) {
+      break;
+    }
+    char *line = buf, *end = buf + carry + n, *nl;
+    while ((nl = memchr(line, '\n', end - line)) != NULL) {
+      *nl = '\0';
+      if (skip) {
+        skip = 0;
+      } else if (sum->ncpu < 0) {
+        if (irq_header(line, sum) != 0) {
+          close(fd);
+          return -1;
+        }
+      } else {
+        irq_row(line, sum);
+      }
+      line = nl + 1;
+    }
+    carry = end - line;
+    if (carry == sizeof(buf) - 1) {
+      carry = 0;
+      skip = 1;
+    }
+    memmove(buf, line, carry);
+  }
+  close(fd);
+  return (sum->ncpu < 0) ? -1 : 0;
+}
+
+void irq_print_count(unsigned long long count) {
+  if (count < 10000) {
+    printf("%llu", count);
+  } else if (count < 10000000) {
+    printf("%.1fK", count / 1e3);
+  } else if (count < 10000000000ULL) {
+    printf("%.1fM", count / 1e6);
+  } else {
+    printf("%.1fG", count / 1e9);
+  }
+}
+
+void tinyirq(void) {
+  static struct irq_summary sum; // per-CPU columns are kept for --interval
+  if (irq_summarize("/proc/interrupts", &sum) != 0 || sum.nsources == 0) {
+    return;
+  }
+  pretext(pretext_irq);
+  for (int i = 0; i < sum.nsources; i++) {
+    printf("%s%s ", (i > 0) ? ", " : "", sum.top[i].name);
+    irq_print_count(sum.top[i].total);
+    if (sum.ncpu > 1) {
+      printf(" (%.0f%% cpu%d)", 100.0 * sum.top[i].max / sum.top[i].total,
+             sum.top[i].max_cpu);
+    }
+  }
+  if (sum.ncpu > 1 && sum.device_total > 0) {
+    int busiest = 0;
+    for (int col = 1; col < sum.ncpu; col++) {
+      if (sum.cpu_total[col] > sum.cpu_total[busiest]) {
+        busiest = col;
+      }
+    }
+    printf("; cpu%d takes %.0f%% of device irqs", sum.cpu_id[busiest],
+           100.0 * sum.cpu_total[busiest] / sum.device_total);
+  }
+  printf("\n");
+}
+#endif
+
+/*
+    block devices
+*/
+
+#if ENABLE_STORAGE && defined(__linux__)
+// orders nvme2n1 before nvme10n1
+int natural_compare(const char *a, const char *b) {
+  while (*a != '\0' && *b != '\0') {
+    if (isdigit((unsigned char)*a) && isdigit((unsigned char)*b)) {
+      char *end_a = (char *)a, *end_b = (char *)b;
+      unsigned long long x = parse_ull(&end_a), y = parse_ull(&end_b);
+      if (x != y) {
+        return (x < y) ? -1 : 1;
+      }
+      a = end_a;
+      b = end_b;
+    } else if (*a != *b) {
+      return (unsigned char)*a - (unsigned char)*b;
+    } else {
+      a++;
+      b++;
+    }
+  }
+  return (unsigned char)*a - (unsigned char)*b;
+}
+
+// reads one attribute into a fixed field, trimmed of the padding SCSI adds
+void storage_attr(int devfd, const char *path, char *out, size_t size) {
+  char buf[128];
+  out[0] = '\0';
+  if (file_read_at(devfd, path, buf, sizeof(buf)) <= 0) {
+    return;
+  }
+  char *start = buf;
+  char *end = strchr(buf, '[');
+  if (end != NULL) { // scheduler lists every choice, the active one bracketed
+    start = end + 1;
+    start[strcspn(start, "]")] = '\0';
+  }
+  while (*start == ' ') {
+    start++;
+  }
+  size_t len = strcspn(start, "\n");
+  while (len > 0 && start[len - 1] == ' ') {
+    len--;
+  }
+  if (len >= size) {
+    len = size - 1;
+  }
+  memcpy(out, start, len);
+  out[len] = '\0';
+}
+
+int storage_read(int blockfd, const char *name, struct storage_dev *dev) {
+  int devfd = openat(blockfd, name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (devfd < 0) {
+    return -1;
+  }
+  char buf[32], *p;
+  snprintf(dev->name, sizeof(dev->name), "%s", name);
+  dev->bytes = 0;
+  if (file_read_at(devfd, "size", buf, sizeof(buf)) > 0) {
+    p = buf;
+    dev->bytes = parse_ull(&p) * 512; // always 512-byte sectors
+  }
+  dev->rotational = -1;
+  if (file_read_at(devfd, "queue/rotational", buf, sizeof(buf)) > 0) {
+    dev->rotational = buf[0] == '1';
+  }
+  dev->nr_requests = 0;
+  if (file_read_at(devfd, "queue/nr_requests", buf, sizeof(buf)) > 0) {
+    p = buf;
+    dev->nr_requests = parse_ull(&p);
+  }
+  storage_attr(devfd, "queue/scheduler", dev->sched, sizeof(dev->sched));
+  storage_attr(devfd, "device/model", dev->model, sizeof(dev->model));
+  close(devfd);
+  return 0;
+}
+
+void storage_print_size(unsigned long long bytes) {
+  const char *units[] = {"MiB", "GiB", "TiB", "PiB"};
+  double size = bytes / 1048576.0;
+  int unit = 0;
+  while (size >= 1024 && unit < 3) {
+    size /= 1024;
+    unit++;
+  }
+  printf("%.1f %s", size, units[unit]);
+}
+
+void tinystorage(void) {
+  DIR *dir = opendir("/sys/block");
+  if (dir == NULL) {
+    return;
+  }
+  int blockfd = dirfd(dir); // the listing fd doubles as the openat base
+
+  // the first STORAGE_SHOWN devices in name order are listed, the rest are
+  // only counted
+  struct storage_dev shown[STORAGE_SHOWN], dev;
+  int num_shown = 0, num_more = 0;
+  unsigned long long more_bytes = 0;
+  struct dirent *entry;
+  while ((entry = readdir(dir)) != NULL) {
+    const char *name = entry->d_name;
+    if (name[0] == '.' || !strncmp(name, "loop", 4) ||
+        !strncmp(name, "ram", 3) || !strncmp(name, "zram", 4) ||
+        storage_read(blockfd, name, &dev) != 0 || dev.bytes == 0) {
+      continue;
+    }
+    int pos = num_shown;
+    while (pos > 0 && natural_compare(shown[pos - 1].name, dev.name) > 0) {
+      pos--;
+    }
+    if (pos == STORAGE_SHOWN) {
+      num_more++;
+      more_bytes += dev.bytes;
+      continue;
+    }
+    if (num_shown == STORAGE_SHOWN) {
+      num_more++;
+      more_bytes += shown[STORAGE_SHOWN - 1].bytes;
+      num_shown--;
+    }
+    memmove(&shown[pos + 1], &shown[pos], (num_shown - pos) * sizeof(dev));
+    shown[pos] = dev;
+    num_shown++;
+  }
+  closedir(dir);
+  if (num_shown == 0) {
+    return;
+  }
+
+  pretext(pretext_storage);
+  for (int i = 0; i < num_shown; i++) {
+    printf("%s%s ", (i > 0) ? ", " : "", shown[i].name);
+    storage_print_size(shown[i].bytes);
+    if (shown[i].model[0] != '\0') {
+      printf(" (%s)", shown[i].model);
+    }
+    if (shown[i].rotational != -1) {
+      printf(" %s", shown[i].rotational ? "hdd" : "ssd");
+    }
+    if (shown[i].sched[0] != '\0') {
+      printf(" %s/%d", shown[i].sched, shown[i].nr_requests);
+    }
+  }
+  if (num_more > 0) {
+    printf(" and %d more (", num_more);
+    storage_print_size(more_bytes);
+    printf(")");
+  }
+  printf("\n");
+}
+#endif
+
+/*
+    network interfaces
+*/
+
+#if ENABLE_NET && defined(__linux__)
+struct net_iface *net_find(struct net_summary *sum, int index) {
+  for (int i = 0; i < sum->num_shown; i++) {
+    if (sum->shown[i].index == index) {
+      return &sum->shown[i];
+    }
+  }
+  return NULL;
+}
+
+void net_link(struct nlmsghdr *nh, struct net_summary *sum) {
+  struct ifinfomsg *ifi = NLMSG_DATA(nh);
+  unsigned int flags = ifi->ifi_flags;
+  if (!(flags & IFF_UP)) {
+    sum->num_down++;
+    return;
+  }
+  if (sum->num_shown == NET_SHOWN) {
+    sum->num_more++;
+    return;
+  }
+  struct net_iface *iface = &sum->shown[sum->num_shown++];
+  memset(iface, 0, sizeof(*iface));
+  iface->index = ifi->ifi_index;
+  iface->carrier = (flags & IFF_RUNNING) != 0;
+  int len = IFLA_PAYLOAD(nh);
+  for (struct rtattr *rta = IFLA_RTA(ifi); RTA_OK(rta, len);
+       rta = RTA_NEXT(rta, len)) {
+    switch (rta->rta_type) {
+    case IFLA_IFNAME:
+      snprintf(iface->name, sizeof(iface->name), "%s", (char *)RTA_DATA(rta));
+      break;
+    case IFLA_MTU:
+      iface->mtu = *(unsigned int *)RTA_DATA(rta);
+      break;
+    case IFLA_NUM_RX_QUEUES:
+      iface->rx_queues = *(unsigned int *)RTA_DATA(rta);
+      break;
+    case IFLA_NUM_TX_QUEUES:
+      iface->tx_queues = *(unsigned int *)RTA_DATA(rta);
+      break;
+    }
+  }
+}
+
+// keeps the first primary IPv4 address, or failing that a global IPv6 one
+void net_addr(struct nlmsghdr *nh, struct net_summary *sum) {
+  struct ifaddrmsg *ifa = NLMSG_DATA(nh);
+  struct net_iface *iface = net_find(sum, ifa->ifa_index);
+  if (iface == NULL || (ifa->ifa_flags & IFA_F_SECONDARY) ||
+      iface->addr_family == AF_INET ||
+      (ifa->ifa_family == AF_INET6 &&
+       (iface->addr_family == AF_INET6 || ifa->ifa_scope != RT_SCOPE_UNIVERSE))) {
+    return;
+  }
+  void *addr = NULL;
+  int len = IFA_PAYLOAD(nh);
+  for (struct rtattr *rta = IFA_RTA(ifa); RTA_OK(rta, len);
+       rta = RTA_NEXT(rta, len)) {
+    // IFA_LOCAL is our end of a point-to-point link, IFA_ADDRESS the peer
+    if (rta->rta_type == IFA_LOCAL ||
+        (rta->rta_type == IFA_ADDRESS && addr == NULL)) {
+      addr = RTA_DATA(rta);
+    }
+  }
+  if (addr != NULL &&
+      inet_ntop(ifa->ifa_family, addr, iface->addr, sizeof(iface->addr))) {
+    iface->addr_family = ifa->ifa_family;
+    iface->prefix = ifa->ifa_prefixlen;
+  }
+}
+
+// sends one dump request and feeds every reply to fn, parsed in place
+int net_dump(int fd, int type, unsigned int seq,
+             void (*fn)(struct nlmsghdr *, struct net_summary *),
+             struct net_summary *sum) {
+  static struct nlmsghdr buf[NET_BUF_SIZE / sizeof(struct nlmsghdr)];
+  struct {
+    struct nlmsghdr nh;
+    struct rtgenmsg gen;
+  } req = {
+      .nh = {.nlmsg_len = sizeof(req),
+             .nlmsg_type = type,
+             .nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP,
+             .nlmsg_seq = seq},
+      .gen = {.rtgen_family = AF_UNSPEC},
+  };
+  if (send(fd, &req, sizeof(req), 0) < 0) {
+    return -1;
+  }
+  for (;;) {
+    ssize_t n = recv(fd, buf, sizeof(buf), 0);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return -1;
+    }
+    int len = n;
+    for (struct nlmsghdr *nh = buf; NLMSG_OK(nh, len); nh = NLMSG_NEXT(nh, len)) {
+      if (nh->nlmsg_seq != seq) {
+        continue;
+      }
+      if (nh->nlmsg_type == NLMSG_DONE) {
+        return 0;
+      }
+      if (nh->nlmsg_type == NLMSG_ERROR) {
+        return -1;
+      }
+      fn(nh, sum);
+    }
+  }
+}
+
+void tinynet(void) {
+  struct net_summary sum;
+  sum.num_shown = sum.num_more = sum.num_down = 0;
+  int fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+  if (fd < 0) {
+    return;
+  }
+  int ok = net_dump(fd, RTM_GETLINK, 1, net_link, &sum) == 0 &&
+           net_dump(fd, RTM_GETADDR, 2, net_addr, &sum) == 0;
+  close(fd);
+  if (!ok || sum.num_shown + sum.num_down == 0) {
+    return;
+  }
+
+  // speed is only in sysfs, and only meaningful on a link with carrier
+  int netfd = open("/sys/class/net", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  pretext(pretext_net);
+  for (int i = 0; i < sum.num_shown; i++) {
+    struct net_iface *iface = &sum.shown[i];
+    printf("%s%s", (i > 0) ? ", " : "", iface->name);
+    if (iface->addr_family != 0) {
+      printf(" %s/%d", iface->addr, iface->prefix);
+    }
+    if (!iface->carrier) {
+      printf(" no-carrier");
+      continue;
+    }
+    printf(" mtu %d", iface->mtu);
+    char path[IF_NAMESIZE + 8], buf[32], *p = buf;
+    snprintf(path, sizeof(path), "%s/speed", iface->name);
+    if (netfd >= 0 && file_read_at(netfd, path, buf, sizeof(buf)) > 0 &&
+        isdigit((unsigned char)buf[0])) {
+      unsigned long long speed = parse_ull(&p);
+      if (speed >= 1000) {
+        printf(" %gGb/s", speed / 1000.0);
+      } else if (speed > 0) {
+        printf(" %lluMb/s", speed);
+      }
+    }
+    if (iface->rx_queues > 1 || iface->tx_queues > 1) {
+      printf(" %drx/%dtx", iface->rx_queues, iface->tx_queues);
+    }
+  }
+  if (netfd >= 0) {
+    close(netfd);
+  }
+  if (sum.num_more > 0) {
+    printf("%s%d more up", (sum.num_shown > 0) ? " and " : "", sum.num_more);
+  }
+  if (sum.num_down > 0) {
+    printf("%s%d down", (sum.num_shown > 0) ? ", " : "", sum.num_down);
+  }
+  printf("\n");
+}
+#endif
+
+/*
+    thermal status
+*/
+
+#if ENABLE_THERMAL && defined(__linux__)
+// finds the coretemp/k10temp inputs once; --interval only re-reads them
+void thermal_discover(struct thermal_cache *cache) {
+  cache->discovered = 1;
+  cache->num_sensors = 0;
+  DIR *dir = opendir(THERMAL_HWMON);
+  if (dir == NULL) {
+    return;
+  }
+  int hwmonfd = dirfd(dir);
+  struct dirent *entry;
+  while ((entry = readdir(dir)) != NULL) {
+    char path[128], buf[64];
+    if (strncmp(entry->d_name, "hwmon", 5) || strlen(entry->d_name) > 16) {
+      continue;
+    }
+    snprintf(path, sizeof(path), "%.16s/name", entry->d_name);
+    if (file_read_at(hwmonfd, path, buf, sizeof(buf)) <= 0 ||
+        (strcmp(buf, "coretemp\n") && strcmp(buf, "k10temp\n"))) {
+      continue;
+    }
+    for (int i = 1; i <= THERMAL_MAX_INPUTS; i++) {
+      if (cache->num_sensors == THERMAL_MAX_SENSORS) {
+        break;
+      }
+      struct thermal_sensor *sensor = &cache->sensors[cache->num_sensors];
+      snprintf(sensor->path, sizeof(sensor->path), "%.16s/temp%d_input",
+               entry->d_name, i);
+      if (faccessat(hwmonfd, sensor->path, R_OK, 0) != 0) {
+        continue; // coretemp numbers its inputs sparsely
+      }
+      // coretemp has "Package id N" and "Core N", k10temp "Tctl"/"Tdie"
+      // for the package and "Tccd N" per chiplet
+      snprintf(path, sizeof(path), "%.16s/temp%d_label", entry->d_name, i);
+      sensor->package = file_read_at(hwmonfd, path, buf, sizeof(buf)) <= 0 ||
+                        !strncmp(buf, "Package", 7) || !strncmp(buf, "Tctl", 4) ||
+                        !strncmp(buf, "Tdie", 4);
+      cache->num_sensors++;
+    }
+  }
+  closedir(dir);
+
+  // thermal_throttle only exists on Intel, and offline CPUs lack it too;
+  // remember which online CPUs have it
+  cache->num_throttle_cpus = 0;
+  memset(cache->throttle_cpus, 0, sizeof(cache->throttle_cpus));
+  int cpufd = open(THERMAL_CPU, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (cpufd < 0) {
+    return;
+  }
+  char online[4096];
+  unsigned long long set[CPUSET_WORDS] = {0};
+  if (file_read_at(cpufd, "online", online, sizeof(online)) > 0) {
+    cpulist_parse(online, set, CPUSET_BITS);
+  }
+  for (int cpu = 0; cpu < CPUSET_BITS; cpu++) {
+    char path[64];
+    if (!CPUSET_ISSET(set, cpu)) {
+      continue;
+    }
+    snprintf(path, sizeof(path), "cpu%d/thermal_throttle", cpu);
+    if (faccessat(cpufd, path, F_OK, 0) != 0) {
+      continue;
+    }
+    CPUSET_SET(cache->throttle_cpus, cpu);
+    cache->num_throttle_cpus++;
+  }
+  close(cpufd);
+}
+
+void tinythermal(void) {
+  static struct thermal_cache cache;
+  if (!cache.discovered) {
+    thermal_discover(&cache);
+  }
+  if (cache.num_sensors == 0) {
+    return; // VMs and most containers have no sensors at all
+  }
+
+  int hwmonfd = open(THERMAL_HWMON, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (hwmonfd < 0) {
+    return;
+  }
+  long package = LONG_MIN, core_min = LONG_MAX, core_max = LONG_MIN;
+  for (int i = 0; i < cache.num_sensors; i++) {
+    char buf[32], *p = buf;
+    if (file_read_at(hwmonfd, cache.sensors[i].path, buf, sizeof(buf)) <= 0) {
+      continue;
+    }
+    long millideg = (buf[0] == '-') ? (p++, -(long)parse_ull(&p))
+                                    : (long)parse_ull(&p);
+    if (cache.sensors[i].package) {
+      package = (millideg > package) ? millideg : package;
+    } else {
+      core_min = (millideg < core_min) ? millideg : core_min;
+      core_max = (millideg > core_max) ? millideg : core_max;
+    }
+  }
+  close(hwmonfd);
+
+  // core counts are per CPU; the package count repeats on every CPU of it
+  unsigned long long core_throttle = 0, package_throttle = 0;
+  int cpufd = open(THERMAL_CPU, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  for (int cpu = 0; cpufd >= 0 && cpu < CPUSET_BITS; cpu++) {
+    char path[80], buf[32], *p;
+    if (!CPUSET_ISSET(cache.throttle_cpus, cpu)) {
+      continue;
+    }
+    snprintf(path, sizeof(path), "cpu%d/thermal_throttle/core_throttle_count",
+             cpu);
+    if (file_read_at(cpufd, path, buf, sizeof(buf)) > 0) {
+      p = buf;
+      core_throttle += parse_ull(&p);
+    }
+    snprintf(path, sizeof(path),
+             "cpu%d/thermal_throttle/package_throttle_count", cpu);
+    if (file_read_at(cpufd, path, buf, sizeof(buf)) > 0) {
+      p = buf;
+      unsigned long long count = parse_ull(&p);
+      package_throttle = (count > package_throttle) ? count : package_throttle;
+    }
+  }
+  if (cpufd >= 0) {
+    close(cpufd);
+  }
+
+  pretext(pretext_thermal);
+  const char *sep = "";
+  if (package != LONG_MIN) {
+    printf("package %ld°C", package / 1000);
+    sep = ", ";
+  }
+  if (core_max != LONG_MIN) {
+    if (core_min / 1000 == core_max / 1000) {
+      printf("%scores %ld°C", sep, core_max / 1000);
+    } else {
+      printf("%scores %ld-%ld°C", sep, core_min / 1000, core_max / 1000);
+    }
+  }
+  if (core_throttle > 0 || package_throttle > 0) {
+    printf(", THROTTLED (%llu core, %llu package events)", core_throttle,
+           package_throttle);
+  } else if (cache.num_throttle_cpus > 0) {
+    printf(", never throttled");
+  }
+  printf("\n");
+}
+#endif
+
+/*
+    CPU vulnerabilities
+*/
+
+#if ENABLE_MITIGATIONS && defined(__linux__)
+// mitigations known to cost real throughput: page table isolation, buffer
+// clearing on every kernel exit, legacy IBRS, return thunks and RSB stuffing
+int mitigation_costly(const char *text) {
+  const char *costly[] = {"PTI",          "Clear CPU buffers",
+                          "Clear Register File", "Untrained return thunk",
+                          "Safe RET",     "IBPB on",
+                          "IBPB: always", "Stuffing",
+                          "Microcode"};
+  if (!strncmp(text, "Mitigation: IBRS", 16)) { // not eIBRS
+    return 1;
+  }
+  for (size_t i = 0; i < sizeof(costly) / sizeof(costly[0]); i++) {
+    if (strstr(text, costly[i]) != NULL) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+int mitigation_classify(const char *text) {
+  if (!strncmp(text, "Not affected", 12)) {
+    return VULN_NOT_AFFECTED;
+  }
+  if (!strncmp(text, "Mitigation:", 11)) {
+    if (strstr(text, "Vulnerable") != NULL) { // e.g. "...; BHI: Vulnerable"
+      return VULN_PARTIAL;
+    }
+    return mitigation_costly(text) ? VULN_COSTLY : VULN_MITIGATED;
+  }
+  if (strstr(text, "ulnerable") != NULL) { // also "Processor vulnerable"
+    return VULN_VULNERABLE;
+  }
+  return VULN_UNKNOWN;
+}
+
+int compare_vuln(const void *a, const void *b) {
+  return strcmp(((const struct vuln *)a)->name, ((const struct vuln *)b)->name);
+}
+
+void mitigations(int verbose) {
+  DIR *dir = opendir("/sys/devices/system/cpu/vulnerabilities");
+  if (dir == NULL) {
+    return; // kernels before 4.15, or not x86/arm64
+  }
+  int vulnfd = dirfd(dir);
+  struct vuln vulns[VULN_MAX];
+  int num_vulns = 0, counts[VULN_KINDS] = {0};
+  struct dirent *entry;
+  while ((entry = readdir(dir)) != NULL && num_vulns < VULN_MAX) {
+    struct vuln *v = &vulns[num_vulns];
+    if (entry->d_name[0] == '.' ||
+        file_read_at(vulnfd, entry->d_name, v->text, sizeof(v->text)) <= 0) {
+      continue;
+    }
+    v->text[strcspn(v->text, "\n")] = '\0';
+    snprintf(v->name, sizeof(v->name), "%.39s", entry->d_name);
+    v->kind = mitigation_classify(v->text);
+    counts[v->kind]++;
+    num_vulns++;
+  }
+  closedir(dir);
+  if (num_vulns == 0) {
+    return;
+  }
+
+  pretext(pretext_mitigations);
+  printf("%d mitigated", counts[VULN_MITIGATED] + counts[VULN_COSTLY]);
+  if (counts[VULN_COSTLY] > 0) {
+    printf(" (%d costly)", counts[VULN_COSTLY]);
+  }
+  if (counts[VULN_PARTIAL] > 0) {
+    printf(", %d partial", counts[VULN_PARTIAL]);
+  }
+  printf(", %d vulnerable", counts[VULN_VULNERABLE]);
+  if (counts[VULN_UNKNOWN] > 0) {
+    printf(", %d unknown", counts[VULN_UNKNOWN]);
+  }
+  printf("\n");
+  if (!verbose) {
+    return;
+  }
+  qsort(vulns, num_vulns, sizeof(vulns[0]), compare_vuln);
+  for (int i = 0; i < num_vulns; i++) {
+    if (vulns[i].kind != VULN_NOT_AFFECTED) {
+      printf("            %s%s: %s\n", vulns[i].name,
+             (vulns[i].kind == VULN_COSTLY) ? " (costly)" : "", vulns[i].text);
+    }
+  }
+}
+
+void tinymitigations(void) { mitigations(0); }
+
+void tinymitigations_verbose(void) { mitigations(1); }
+#endif
+
+/*
+    kernel tuning
+*/
+
+#if ENABLE_TUNING && defined(__linux__)
+// collapses runs of blanks (tcp_rmem and friends are tab separated) and
+// trims the ends, so file and baseline values compare as strings
+void tuning_normalize(char *value) {
+  char *out = value;
+  for (char *c = value; *c != '\0'; c++) {
+    if (isspace((unsigned char)*c)) {
+      if (out != value && out[-1] != ' ') {
+        *out++ = ' ';
+      }
+    } else {
+      *out++ = *c;
+    }
+  }
+  if (out != value && out[-1] == ' ') {
+    out--;
+  }
+  *out = '\0';
+}
+
+// sysctl.conf syntax: "key = value", # and ; comments, and an optional
+// leading "-"; only keys in tuning_knobs are used, the rest are ignored
+int tuning_load_baseline(const char *path) {
+  static char *buf; // the baseline values point into it
+  static size_t cap;
+  // all of it or nothing: a cut-off last value would report false drift
+  if (file_read_all(AT_FDCWD, path, &buf, &cap, TUNING_BASELINE_MAX) < 0) {
+    return -1;
+  }
+  for (char *line = buf; line != NULL && *line != '\0';) {
+    char *next = strchr(line, '\n');
+    if (next != NULL) {
+      *next++ = '\0';
+    }
+    char *eq = strchr(line, '=');
+    while (*line == ' ' || *line == '\t' || *line == '-') {
+      line++;
+    }
+    if (eq != NULL && *line != '#' && *line != ';') {
+      *eq = '\0';
+      tuning_normalize(line);
+      tuning_normalize(eq + 1);
+      for (size_t i = 0; i < TUNING_KNOBS; i++) {
+        if (!strcmp(line, tuning_knobs[i].name)) {
+          tuning_knobs[i].baseline = eq + 1;
+        }
+      }
+    }
+    line = next;
+  }
+  return 0;
+}
+
+void tinytuning(void) {
+  static int loaded;
+  if (!loaded && tuning_baseline != NULL) {
+    if (tuning_load_baseline(tuning_baseline) != 0) {
+      printf("tinyfetch: can't read tuning baseline %s: %s\n", tuning_baseline,
+             strerror(errno));
+      return;
+    }
+    loaded = 1;
+  }
+  int sysfd = open("/proc/sys", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (sysfd < 0) {
+    return;
+  }
+
+  int differ = 0;
+  for (size_t i = 0; i < TUNING_KNOBS; i++) {
+    char path[128], value[256];
+    snprintf(path, sizeof(path), "%s", tuning_knobs[i].name);
+    for (char *c = path; *c != '\0'; c++) {
+      *c = (*c == '.') ? '/' : *c;
+    }
+    if (file_read_at(sysfd, path, value, sizeof(value)) <= 0) {
+      continue; // not in this kernel, or not readable
+    }
+    tuning_normalize(value);
+    const char *baseline = tuning_knobs[i].baseline;
+    if (baseline == NULL) { // numa_balancing is switched on for NUMA hardware
+      baseline = access("/sys/devices/system/node/node1", F_OK) == 0 ? "1"
+                                                                     : "0";
+    }
+    if (!strcmp(value, baseline)) {
+      continue;
+    }
+    if (differ++ == 0) {
+      pretext(pretext_tuning);
+    } else {
+      printf(", ");
+    }
+    printf("%s=%s (%s)", tuning_knobs[i].name, value, baseline);
+  }
+  close(sysfd);
+  if (differ > 0) {
+    printf("\n");
+  }
+}
+#endif
+
+/*
+    latency tuning
+*/
+
+#if ENABLE_LATENCY && defined(__linux__)
+// copies the cpulist of a kernel parameter out of /proc/cmdline; isolcpus
+// may lead with flags ("isolcpus=nohz,domain,2-7"), which go into flags
+int cmdline_cpulist(const char *cmdline, const char *param, char *out,
+                    size_t size, char *flags, size_t flags_size) {
+  size_t len = strlen(param);
+  for (const char *c = cmdline; *c != '\0';) {
+    size_t word = strcspn(c, " \n");
+    if (word == 2 && !strncmp(c, "--", 2)) {
+      break; // everything after "--" belongs to init
+    }
+    if (word > len && !strncmp(c, param, len) && c[len] == '=') {
+      const char *list = c + len + 1;
+      while (isalpha((unsigned char)*list)) { // a flag, skip it and its comma
+        list += strcspn(list, ", \n");
+        list += (*list == ',');
+      }
+      if (flags != NULL) {
+        int n = (int)(list - (c + len + 1)) - (list[-1] == ',');
+        snprintf(flags, flags_size, "%.*s", n > 0 ? n : 0, c + len + 1);
+      }
+      size_t n = c + word - list;
+      if (n >= size) {
+        n = size - 1;
+      }
+      memcpy(out, list, n);
+      out[n] = '\0';
+      return 0;
+    }
+    c += word;
+    while (*c == ' ' || *c == '\n') {
+      c++;
+    }
+  }
+  return -1;
+}
+
+// sysfs lists are empty (or "(null)" for nohz_full) when nothing is set
+void sysfs_cpulist(const char *path, char *out, size_t size) {
+  if (file_read_at(AT_FDCWD, path, out, size) <= 0 || out[0] == '(') {
+    out[0] = '\0';
+  }
+  out[strcspn(out, "\n")] = '\0';
+}
+
+// lists the parser can't follow (the kernel also takes "all" and "N") are
+// not second-guessed
+int cpulist_equal(const char *a, const char *b) {
+  const char *syntax = "0123456789,-:/";
+  if (a[strspn(a, syntax)] != '\0' || b[strspn(b, syntax)] != '\0') {
+    return 1;
+  }
+  unsigned long long set_a[CPUSET_WORDS] = {0}, set_b[CPUSET_WORDS] = {0};
+  char list_a[LATENCY_LIST_SIZE], list_b[LATENCY_LIST_SIZE];
+  snprintf(list_a, sizeof(list_a), "%s", a);
+  snprintf(list_b, sizeof(list_b), "%s", b);
+  return cpulist_parse(list_a, set_a, CPUSET_BITS) ==
+             cpulist_parse(list_b, set_b, CPUSET_BITS) &&
+         !memcmp(set_a, set_b, sizeof(set_a));
+}
+
+// prints what is in effect, and what the command line asked for if that
+// is not what the kernel ended up doing
+void latency_set(const char *name, const char *effective,
+                 const char *requested) {
+  printf("%s %s", name, (effective[0] != '\0') ? effective : "none");
+  if (requested[0] != '\0' && !cpulist_equal(effective, requested)) {
+    printf(" (requested %s!)", requested);
+  }
+}
+
+void tinylatency(void) {
+  char cmdline[4096], isolated[LATENCY_LIST_SIZE], nohz[LATENCY_LIST_SIZE];
+  char want_isolated[LATENCY_LIST_SIZE] = "", want_nohz[LATENCY_LIST_SIZE] = "";
+  char rcu_nocbs[LATENCY_LIST_SIZE] = "", clocksource[64];
+  char isolcpus_flags[64] = "";
+  if (file_read_at(AT_FDCWD, "/proc/cmdline", cmdline, sizeof(cmdline)) > 0) {
+    cmdline_cpulist(cmdline, "isolcpus", want_isolated, sizeof(want_isolated),
+                    isolcpus_flags, sizeof(isolcpus_flags));
+    cmdline_cpulist(cmdline, "nohz_full", want_nohz, sizeof(want_nohz), NULL,
+                    0);
+    cmdline_cpulist(cmdline, "rcu_nocbs", rcu_nocbs, sizeof(rcu_nocbs), NULL,
+                    0);
+  }
+  // sysfs "isolated" only shows domain isolation: isolcpus=managed_irq,2-7
+  // or isolcpus=nohz,2-7 leave it empty on a correctly set up host
+  int domain = isolcpus_flags[0] == '\0' ||
+               strstr(isolcpus_flags, "domain") != NULL;
+  sysfs_cpulist("/sys/devices/system/cpu/isolated", isolated,
+                sizeof(isolated));
+  sysfs_cpulist("/sys/devices/system/cpu/nohz_full", nohz, sizeof(nohz));
+  if (file_read_at(AT_FDCWD,
+                   "/sys/devices/system/clocksource/clocksource0/"
+                   "current_clocksource",
+                   clocksource, sizeof(clocksource)) <= 0) {
+    clocksource[0] = '\0';
+  }
+  clocksource[strcspn(clocksource, "\n")] = '\0';
+
+  pretext(pretext_latency);
+  latency_set("isolated", isolated, domain ? want_isolated : "");
+  if (!domain && want_isolated[0] != '\0') {
+    printf(" (%s %s)", isolcpus_flags, want_isolated);
+  }
+  latency_set(", nohz_full", nohz, want_nohz);
+  if (rcu_nocbs[0] != '\0') {
+    printf(", rcu_nocbs %s", rcu_nocbs);
+  }
+  if (clocksource[0] != '\0') {
+    printf(", clocksource %s", clocksource);
+    // anything else (hpet, acpi_pm, a paravirt clock) makes clock_gettime
+    // slower or leave the vDSO
+    if (strcmp(clocksource, "tsc") && strcmp(clocksource, "arch_sys_counter")) {
+      printf(" (not tsc!)");
+    }
+  }
+  printf("\n");
+}
+#endif
+
+/*
+    hardware probe
+*/
+
+#if ENABLE_HWPROBE && defined(__linux__)
+// a barrier whose size can shrink when a worker fails to start
+void hwprobe_sync(struct hwprobe *hp) {
+  pthread_mutex_lock(&hp->lock);
+  int generation = hp->generation;
+  if (++hp->arrived >= hp->nthreads) {
+    hp->arrived = 0;
+    hp->generation++;
+    pthread_cond_broadcast(&hp->cond);
+  } else {
+    while (generation == hp->generation) {
+      pthread_cond_wait(&hp->cond, &hp->lock);
+    }
+  }
+  pthread_mutex_unlock(&hp->lock);
+}
+
+double hwprobe_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// four independent integer and FP dependency chains, so the score follows
+// the sustained clock and the core's execution width, not memory. runs
+// HWPROBE_CORE_ITERS or HWPROBE_BUDGET_MS, whichever ends first
+double hwprobe_core(void) {
+  unsigned long long x0 = 1, x1 = 2, x2 = 3, x3 = 4;
+  double f0 = 1.0, f1 = 2.0, f2 = 3.0, f3 = 4.0;
+  double start = hwprobe_now(), elapsed = 0;
+  long iters = 0;
+  while (iters < HWPROBE_CORE_ITERS && elapsed < HWPROBE_BUDGET_MS / 1e3) {
+    for (int i = 0; i < HWPROBE_CORE_CHUNK; i++) {
+      x0 = x0 * 6364136223846793005ULL + 1442695040888963407ULL;
+      x1 = x1 * 6364136223846793005ULL + 1442695040888963407ULL;
+      x2 = x2 * 6364136223846793005ULL + 1442695040888963407ULL;
+      x3 = x3 * 6364136223846793005ULL + 1442695040888963407ULL;
+      f0 = f0 * 0.9999999 + 1e-7;
+      f1 = f1 * 0.9999999 + 1e-7;
+      f2 = f2 * 0.9999999 + 1e-7;
+      f3 = f3 * 0.9999999 + 1e-7;
+    }
+    iters += HWPROBE_CORE_CHUNK;
+    elapsed = hwprobe_now() - start;
+  }
+  volatile double sink = (double)(x0 ^ x1 ^ x2 ^ x3) + f0 + f1 + f2 + f3;
+  (void)sink;
+  return 8.0 * iters / elapsed / 1e6; // Mops/s
+}
+
+void *hwprobe_worker(void *data) {
+  struct hwprobe_worker *w = data;
+  struct hwprobe *hp = w->hp;
+  unsigned long long mask[CPUSET_WORDS] = {0};
+  CPUSET_SET(mask, w->cpu);
+  w->pinned = syscall(SYS_sched_setaffinity, 0, sizeof(mask), mask) == 0;
+
+  // allocated and first touched after pinning, so the pages are local; an
+  // unpinned worker still meets the barriers but moves no memory
+  double *a = NULL, *b = NULL, *c = NULL;
+  size_t n = w->pinned ? hp->array_bytes / sizeof(double) : 0;
+  if (n > 0 && (posix_memalign((void **)&a, 64, n * sizeof(double)) != 0 ||
+                posix_memalign((void **)&b, 64, n * sizeof(double)) != 0 ||
+                posix_memalign((void **)&c, 64, n * sizeof(double)) != 0)) {
+    n = 0;
+  }
+  for (size_t i = 0; i < n; i++) {
+    a[i] = 1.0;
+    b[i] = 2.0;
+    c[i] = 0.0;
+  }
+  w->n = n;
+
+  // STREAM copy and triad, best of up to HWPROBE_REPS, timed by worker 0
+  // between barriers so the slowest thread bounds each pass. worker 0 also
+  // ends the passes once HWPROBE_BUDGET_MS is spent, and everyone sees that
+  // decision after the next barrier
+  double budget_start = hwprobe_now();
+  for (int rep = 0; rep < HWPROBE_REPS; rep++) {
+    hwprobe_sync(hp);
+    double start = hwprobe_now();
+    for (size_t i = 0; i < n; i++) {
+      c[i] = a[i];
+    }
+    hwprobe_sync(hp);
+    double mid = hwprobe_now();
+    for (size_t i = 0; i < n; i++) {
+      a[i] = b[i] + 3.0 * c[i];
+    }
+    hwprobe_sync(hp);
+    if (w->id == 0) {
+      double copy = mid - start, triad = hwprobe_now() - mid;
+      hp->copy_time = (rep == 0 || copy < hp->copy_time) ? copy : hp->copy_time;
+      hp->triad_time =
+          (rep == 0 || triad < hp->triad_time) ? triad : hp->triad_time;
+      hp->stop = hwprobe_now() - budget_start >= HWPROBE_BUDGET_MS / 1e3;
+    }
+    hwprobe_sync(hp);
+    if (hp->stop) {
+      break;
+    }
+  }
+  free(a);
+  free(b);
+  free(c);
+
+  hwprobe_sync(hp); // every core loaded at once, as in real use
+  w->core_mops = hwprobe_core();
+  return NULL;
+}
+
+// total last level cache behind the given cores: cpu0's L3 size times the
+// number of distinct L3 instances, 0 if sysfs has no L3
+size_t hwprobe_llc_bytes(const int *cores, int num_cores) {
+  char path[80], buf[64], *p = buf;
+  if (file_read_at(AT_FDCWD, "/sys/devices/system/cpu/cpu0/cache/index3/size",
+                   buf, sizeof(buf)) <= 0) {
+    return 0;
+  }
+  size_t size = parse_ull(&p);
+  size <<= (*p == 'K') ? 10 : (*p == 'M') ? 20 : 0;
+
+  unsigned long long leaders[CPUSET_WORDS] = {0};
+  int instances = 0;
+  for (int i = 0; i < num_cores; i++) {
+    snprintf(path, sizeof(path),
+             "/sys/devices/system/cpu/cpu%d/cache/index3/shared_cpu_list",
+             cores[i]);
+    p = buf;
+    if (file_read_at(AT_FDCWD, path, buf, sizeof(buf)) <= 0) {
+      continue;
+    }
+    int leader = (int)parse_ull(&p);
+    if (leader >= 0 && leader < CPUSET_BITS && !CPUSET_ISSET(leaders, leader)) {
+      CPUSET_SET(leaders, leader);
+      instances++;
+    }
+  }
+  return size * (instances > 0 ? instances : 1);
+}
+
+// runs once per process: one pinned worker per physical core
+struct hwprobe *hwprobe_run(void) {
+  static struct hwprobe hp;
+  static struct hwprobe_worker workers[HWPROBE_MAX_THREADS];
+  if (hp.done) {
+    return (hp.nthreads > 0) ? &hp : NULL;
+  }
+  hp.done = 1;
+
+  // only the CPUs we may run on: taskset, cpusets and containers shrink
+  // this below the online list
+  char buf[4096];
+  unsigned long long allowed[CPUSET_WORDS] = {0};
+  if (syscall(SYS_sched_getaffinity, 0, sizeof(allowed), allowed) <= 0) {
+    return NULL;
+  }
+  int cores[HWPROBE_MAX_THREADS], num_cores = 0;
+  for (int cpu = 0; cpu < CPUSET_BITS && num_cores < HWPROBE_MAX_THREADS;
+       cpu++) {
+    if (!CPUSET_ISSET(allowed, cpu)) {
+      continue;
+    }
+    // a core is led by the lowest of its SMT siblings we are allowed on
+    char path[80];
+    unsigned long long siblings[CPUSET_WORDS] = {0};
+    snprintf(path, sizeof(path),
+             "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list",
+             cpu);
+    if (file_read_at(AT_FDCWD, path, buf, sizeof(buf)) > 0) {
+      cpulist_parse(buf, siblings, CPUSET_BITS);
+      int leader = 0;
+      while (leader < cpu &&
+             !(CPUSET_ISSET(siblings, leader) && CPUSET_ISSET(allowed, leader))) {
+        leader++;
+      }
+      if (leader != cpu) {
+        continue;
+      }
+    }
+    cores[num_cores++] = cpu;
+  }
+  if (num_cores == 0) {
+    return NULL;
+  }
+
+  pthread_mutex_init(&hp.lock, NULL);
+  pthread_cond_init(&hp.cond, NULL);
+  hp.nthreads = num_cores;
+  // twice the last level cache per array, within HWPROBE_MIN_BYTES..
+  // HWPROBE_MAX_BYTES in all. STREAM's four times would page in gigabytes on
+  // big L3 parts for a status line; where L3 outgrows the cap the figures
+  // lean towards cache bandwidth, which is the price of a ~200 ms probe. a
+  // small machine gets no more than a quarter of its RAM
+  size_t total = 2 * hwprobe_llc_bytes(cores, num_cores);
+  if (total < HWPROBE_MIN_BYTES / 3) {
+    total = HWPROBE_MIN_BYTES / 3;
+  }
+  if (total > HWPROBE_MAX_BYTES / 3) {
+    total = HWPROBE_MAX_BYTES / 3;
+  }
+  struct sysinfo info;
+  if (sysinfo(&info) == 0 &&
+      total > (size_t)info.totalram * info.mem_unit / 4 / 3) {
+    total = (size_t)info.totalram * info.mem_unit / 4 / 3;
+  }
+  hp.array_bytes = total / num_cores;
+  if (hp.array_bytes < HWPROBE_MIN_ARRAY) {
+    hp.array_bytes = HWPROBE_MIN_ARRAY;
+  }
+  int started = 0;
+  for (; started < num_cores; started++) {
+    workers[started].id = started;
+    workers[started].cpu = cores[started];
+    workers[started].hp = &hp;
+    if (pthread_create(&workers[started].thread, NULL, hwprobe_worker,
+                       &workers[started]) != 0) {
+      break;
+    }
+  }
+  if (started < num_cores) { // carry on with the workers we have
+    pthread_mutex_lock(&hp.lock);
+    hp.nthreads = started;
+    if (started > 0 && hp.arrived >= started) {
+      hp.arrived = 0;
+      hp.generation++;
+      pthread_cond_broadcast(&hp.cond);
+    }
+    pthread_mutex_unlock(&hp.lock);
+  }
+
+  double bytes = 0;
+  hp.core_avg = 0;
+  hp.core_min = 0;
+  int pinned = 0;
+  for (int i = 0; i < started; i++) {
+    pthread_join(workers[i].thread, NULL);
+    if (!workers[i].pinned) { // a score from an unknown core means nothing
+      continue;
+    }
+    bytes += workers[i].n * sizeof(double);
+    hp.core_avg += workers[i].core_mops;
+    if (pinned++ == 0 || workers[i].core_mops < hp.core_min) {
+      hp.core_min = workers[i].core_mops;
+    }
+  }
+  if (pinned > 0) {
+    hp.core_avg /= pinned;
+  }
+  if (started == 0 || bytes == 0) {
+    hp.nthreads = 0;
+    return NULL;
+  }
+  // copy moves each byte twice (read a, write c), triad three times
+  hp.copy_gbs = 2 * bytes / hp.copy_time / 1e9;
+  hp.triad_gbs = 3 * bytes / hp.triad_time / 1e9;
+  return &hp;
+}
+#endif
+
+/*
+    batch rendering
+*/
+
+#if ENABLE_BATCH && defined(__linux__)
+// reads a whole snapshot file, growing the worker's buffer as needed
+char *batch_read(int hostfd, const char *name, struct batch_buf *b) {
+  if (file_read_all(hostfd, name, &b->data, &b->cap, BATCH_FILE_MAX) < 0) {
+    return NULL;
+  }
+  return b->data;
+}
+
+// makes room for n more bytes and the NUL. a record that can't grow is
+// failed as a whole rather than cut off into invalid JSON
+int json_reserve(struct batch_json *j, size_t n) {
+  if (j->failed) {
+    return -1;
+  }
+  if (j->len + n + 1 <= j->cap) {
+    return 0;
+  }
+  size_t cap = (j->cap < 1024) ? 1024 : j->cap;
+  while (cap < j->len + n + 1) {
+    cap *= 2;
+  }
+  char *out = realloc(j->out, cap);
+  if (out == NULL) {
+    j->failed = 1;
+    return -1;
+  }
+  j->out = out;
+  j->cap = cap;
+  return 0;
+}
+
+void json_string(struct batch_json *j, const char *key, const char *value) {
+  // "\u00xx" is the longest escape, six bytes for one
+  size_t room = strlen(key) + 8 + ((value != NULL) ? 6 * strlen(value) : 4);
+  if (json_reserve(j, room) != 0) {
+    return;
+  }
+  j->len += sprintf(j->out + j->len, "%s\"%s\":", (j->len > 1) ? "," : "", key);
+  if (value == NULL) {
+    j->len += sprintf(j->out + j->len, "null");
+    return;
+  }
+  j->out[j->len++] = '"';
+  for (const unsigned char *c = (const unsigned char *)value; *c != '\0';
+       c++) {
+    if (*c == '"' || *c == '\\') {
+      j->out[j->len++] = '\\';
+      j->out[j->len++] = *c;
+    } else if (*c < 0x20) {
+      j->len += sprintf(j->out + j->len, "\\u%04x", *c);
+    } else {
+      j->out[j->len++] = *c;
+    }
+  }
+  j->out[j->len++] = '"';
+  j->out[j->len] = '\0';
+}
+
+void json_number(struct batch_json *j, const char *key, long long value) {
+  if (json_reserve(j, strlen(key) + 32) != 0) {
+    return;
+  }
+  j->len += sprintf(j->out + j->len,
+                    (value >= 0) ? "%s\"%s\":%lld" : "%s\"%s\":null",
+                    (j->len > 1) ? "," : "", key, value);
+}
+
+// one snapshot directory (meminfo, cpuinfo, os-release and uname, the
+// output of "uname -snrm") to one JSON line
+char *batch_render(int dirfd, const char *host, struct batch_buf *b) {
+  struct batch_json j = {NULL, 0, 0, 0};
+  if (json_reserve(&j, 1) != 0) {
+    return NULL;
+  }
+  j.out[j.len++] = '{';
+  j.out[j.len] = '\0';
+  json_string(&j, "host", host);
+
+  int hostfd = openat(dirfd, host, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (hostfd < 0) {
+    json_string(&j, "error", strerror(errno));
+  } else {
+    char *buf = batch_read(hostfd, "uname", b);
+    char field[4][256] = {"", "", "", ""};
+    for (int i = 0; buf != NULL && i < 4; i++) {
+      buf += strspn(buf, " \t");
+      size_t n = strcspn(buf, " \t\n");
+      n = (n < sizeof(field[i])) ? n : sizeof(field[i]) - 1;
+      memcpy(field[i], buf, n);
+      field[i][n] = '\0';
+      buf += n;
+    }
+    json_string(&j, "hostname", field[1][0] ? field[1] : NULL);
+    char os[264];
+    snprintf(os, sizeof(os), "%s%s", !strcmp(field[0], "Linux") ? "GNU/" : "",
+             field[0]);
+    json_string(&j, "os", field[0][0] ? os : NULL);
+    json_string(&j, "kernel", field[2][0] ? field[2] : NULL);
+    json_string(&j, "arch", field[3][0] ? field[3] : NULL);
+
+    char name[256], version[256], distro[512];
+    int have_name = 0, have_version = 0;
+    if ((buf = batch_read(hostfd, "os-release", b)) != NULL) {
+      have_name = os_release_name(buf, name, sizeof(name)) == 0;
+      have_version =
+          os_release_field(buf, "VERSION_ID", version, sizeof(version)) == 0;
+    }
+    distro_string(distro, sizeof(distro), have_name ? name : NULL,
+                  have_version ? version : NULL);
+    json_string(&j, "distro", distro);
+
+    char model[256], cpu[320];
+    int cpus = -1;
+    if ((buf = batch_read(hostfd, "cpuinfo", b)) != NULL) {
+      cpus = cpuinfo_parse(buf, model, sizeof(model));
+      snprintf(cpu, sizeof(cpu), "%s (%d)", model, cpus);
+    }
+    json_string(&j, "cpu", (cpus > 0 && model[0] != '\0') ? cpu : NULL);
+    json_number(&j, "cpus", cpus);
+
+    struct tinymeminfo mi;
+    if ((buf = batch_read(hostfd, "meminfo", b)) != NULL) {
+      meminfo_parse(buf, &mi);
+    } else {
+      meminfo_parse("", &mi);
+    }
+    long long avail = (mi.mem_available != -1) ? mi.mem_available : mi.mem_free;
+    json_number(&j, "mem_total",
+                (mi.mem_total >= 0) ? mi.mem_total * 1024 : -1);
+    json_number(&j, "mem_available", (avail >= 0) ? avail * 1024 : -1);
+    json_number(&j, "swap_total",
+                (mi.swap_total >= 0) ? mi.swap_total * 1024 : -1);
+    json_number(&j, "swap_free",
+                (mi.swap_free >= 0) ? mi.swap_free * 1024 : -1);
+    close(hostfd);
+  }
+  if (json_reserve(&j, 2) != 0) {
+    free(j.out);
+    return NULL; // printed as batch->failed
+  }
+  memcpy(j.out + j.len, "}\n", 3);
+  return j.out;
+}
+
+// a worker's share of the hosts, [head, tail) packed in one word so the
+// owner (popping at head) and thieves (cutting from tail) race on one CAS
+#define BATCH_PACK(head, tail) ((unsigned long long)(tail) << 32 | (head))
+
+int batch_pop(struct batch_worker *w) {
+  unsigned long long range = atomic_load(&w->range);
+  for (;;) {
+    unsigned int head = range & 0xffffffff, tail = range >> 32;
+    if (head >= tail) {
+      return -1;
+    }
+    if (atomic_compare_exchange_weak(&w->range, &range,
+                                     BATCH_PACK(head + 1, tail))) {
+      return head;
+    }
+  }
+}
+
+// takes the upper half of the first victim with work left, and keeps one
+// of the stolen hosts for itself
+int batch_steal(struct batch *batch, struct batch_worker *self) {
+  for (int i = 1; i < batch->num_workers; i++) {
+    struct batch_worker *victim =
+        &batch->workers[(self->id + i) % batch->num_workers];
+    unsigned long long range = atomic_load(&victim->range);
+    for (;;) {
+      unsigned int head = range & 0xffffffff, tail = range >> 32;
+      if (head >= tail) {
+        break;
+      }
+      unsigned int cut = tail - (tail - head + 1) / 2;
+      if (atomic_compare_exchange_weak(&victim->range, &range,
+                                       BATCH_PACK(head, cut))) {
+        atomic_store(&self->range, BATCH_PACK(cut + 1, tail));
+        return cut;
+      }
+    }
+  }
+  return -1;
+}
+
+void *batch_worker(void *data) {
+  struct batch_worker *w = data;
+  struct batch *batch = w->batch;
+  struct batch_buf b = {NULL, 0};
+  int host;
+  while ((host = batch_pop(w)) >= 0 || (host = batch_steal(batch, w)) >= 0) {
+    char *line = batch_render(batch->dirfd, batch->hosts[host], &b);
+    pthread_mutex_lock(&batch->lock);
+    batch->lines[host] = (line != NULL) ? line : batch->failed;
+    if (host == batch->next) {
+      pthread_cond_signal(&batch->ready);
+    }
+    pthread_mutex_unlock(&batch->lock);
+  }
+  free(b.data);
+  return NULL;
+}
+
+int compare_string(const void *a, const void *b) {
+  return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+// renders every snapshot under dir, streaming the lines in name order
+int tinybatch(const char *dir) {
+  struct batch batch;
+  memset(&batch, 0, sizeof(batch));
+  DIR *d = opendir(dir);
+  if (d == NULL) {
+    printf("tinyfetch: can't open batch directory %s\n", dir);
+    return 1;
+  }
+  int cap = 0;
+  struct dirent *entry;
+  while ((entry = readdir(d)) != NULL) {
+    if (entry->d_name[0] == '.') {
+      continue;
+    }
+    if (batch.num_hosts == cap) {
+      cap = (cap == 0) ? 1024 : cap * 2;
+      char **hosts = realloc(batch.hosts, cap * sizeof(char *));
+      if (hosts == NULL) {
+        break;
+      }
+      batch.hosts = hosts;
+    }
+    if ((batch.hosts[batch.num_hosts] = strdup(entry->d_name)) != NULL) {
+      batch.num_hosts++;
+    }
+  }
+  if (batch.num_hosts == 0) {
+    closedir(d);
+    free(batch.hosts);
+    return 0;
+  }
+  qsort(batch.hosts, batch.num_hosts, sizeof(char *), compare_string);
+  batch.dirfd = dirfd(d);
+  batch.lines = calloc(batch.num_hosts, sizeof(char *));
+  batch.failed = "{\"error\":\"out of memory\"}\n";
+  batch.num_workers = get_cpu_count();
+  if (batch.num_workers > BATCH_MAX_WORKERS) {
+    batch.num_workers = BATCH_MAX_WORKERS;
+  }
+  if (batch.num_workers > batch.num_hosts) {
+    batch.num_workers = batch.num_hosts;
+  }
+  if (batch.num_workers < 1) {
+    batch.num_workers = 1;
+  }
+  batch.workers = calloc(batch.num_workers, sizeof(struct batch_worker));
+  if (batch.lines == NULL || batch.workers == NULL) {
+    printf("tinyfetch: out of memory\n");
+    for (int i = 0; i < batch.num_hosts; i++) {
+      free(batch.hosts[i]);
+    }
+    free(batch.hosts);
+    free(batch.lines);
+    free(batch.workers);
+    closedir(d);
+    return 1;
+  }
+  pthread_mutex_init(&batch.lock, NULL);
+  pthread_cond_init(&batch.ready, NULL);
+
+  // contiguous shares to start with; stealing evens out slow snapshots
+  int started = 0;
+  for (int i = 0; i < batch.num_workers; i++) {
+    struct batch_worker *w = &batch.workers[i];
+    w->id = i;
+    w->batch = &batch;
+    atomic_init(&w->range,
+                BATCH_PACK((long long)batch.num_hosts * i / batch.num_workers,
+                           (long long)batch.num_hosts * (i + 1) /
+                               batch.num_workers));
+  }
+  for (; started < batch.num_workers; started++) {
+    if (pthread_create(&batch.workers[started].thread, NULL, batch_worker,
+                       &batch.workers[started]) != 0) {
+      break; // the running workers steal what the others would have done
+    }
+  }
+  if (started == 0) {
+    batch_worker(&batch.workers[0]);
+  }
+
+  pthread_mutex_lock(&batch.lock);
+  for (; batch.next < batch.num_hosts; batch.next++) {
+    while (batch.lines[batch.next] == NULL) {
+      pthread_cond_wait(&batch.ready, &batch.lock);
+    }
+    char *line = batch.lines[batch.next];
+    pthread_mutex_unlock(&batch.lock);
+    fputs(line, stdout);
+    if (line != batch.failed) {
+      free(line);
+    }
+    pthread_mutex_lock(&batch.lock);
+  }
+  pthread_mutex_unlock(&batch.lock);
+
+  for (int i = 0; i < started; i++) {
+    pthread_join(batch.workers[i].thread, NULL);
+  }
+  for (int i = 0; i < batch.num_hosts; i++) {
+    free(batch.hosts[i]);
+  }
+  free(batch.hosts);
+  free(batch.lines);
+  free(batch.workers);
+  closedir(d);
+  return 0;
+}
+#endif
+
+/*
+    probes
+*/
+
+// every source that can block (NSS, procfs of a foreign process, libpci) runs
+// on its own detached thread. the printing side waits for it until the
+// probe's deadline and then moves on; a wedged thread is abandoned and frees
+// its own result if it ever returns.
+
+pthread_mutex_t probe_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t probe_cond;
+pthread_once_t probe_once = PTHREAD_ONCE_INIT;
+
+// compiled-out collectors leave an empty slot behind and are never started
+struct tinyprobe probes[PROBE_COUNT] = {
+#if ENABLE_USER
+    [PROBE_USER] = {"user", probe_user, -1},
+#endif
+#if ENABLE_DISTRO
+    [PROBE_DISTRO] = {"distro", probe_distro, -1},
+#endif
+#if ENABLE_SHELL
+    [PROBE_SHELL] = {"shell", probe_shell, -1},
+#endif
+#if ENABLE_CPU
+    [PROBE_CPU] = {"cpu", probe_cpu, -1},
+#endif
+#if PCI_DETECTION == 1
+    [PROBE_GPU] = {"gpu", probe_gpu, 200}, // pci.ids lookups are slow
+#else
+    [PROBE_GPU] = {"gpu", NULL, 200},
+#endif
+};
+
+void probe_init(void) {
+  pthread_condattr_t attr;
+  pthread_condattr_init(&attr);
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  pthread_cond_init(&probe_cond, &attr);
+  pthread_condattr_destroy(&attr);
+}
+
+void *probe_thread(void *data) {
+  struct tinyprobe *p = data;
+#if ENABLE_PERF_STAT && defined(__linux__)
+  // counted here rather than inherited, so the work lands on the probe and
+  // not on whichever field happens to be running when the thread exits
+  int fds[PERF_COUNTERS];
+  unsigned long long before[PERF_COUNTERS], after[PERF_COUNTERS];
+  struct timespec start, end;
+  if (perf_enable) {
+    perf_open_counters(fds);
+    perf_read(fds, before);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+  }
+#endif
+  char *result = p->fn(p->arg);
+#if ENABLE_PERF_STAT && defined(__linux__)
+  if (perf_enable) {
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    perf_read(fds, after);
+    for (int i = 0; i < PERF_COUNTERS; i++) {
+      if (fds[i] >= 0) {
+        close(fds[i]);
+      }
+    }
+  }
+#endif
+
+  pthread_mutex_lock(&probe_lock);
+#if ENABLE_PERF_STAT && defined(__linux__)
+  if (perf_enable) {
+    for (int i = 0; i < PERF_COUNTERS; i++) {
+      p->perf_counts[i] = after[i] - before[i];
+    }
+    p->perf_ms = (end.tv_sec - start.tv_sec) * 1e3 +
+                 (end.tv_nsec - start.tv_nsec) / 1e6;
+    p->perf_measured = 1;
+  }
+#endif
+  p->running = 0;
+  if (p->abandoned) {
+    free(result); // nobody is waiting for this anymore
+  } else {
+    p->result = result;
+    p->done = 1;
+  }
+  pthread_cond_broadcast(&probe_cond);
+  pthread_mutex_unlock(&probe_lock);
+  return NULL;
+}
+
+void probe_start(struct tinyprobe *p) {
+  pthread_once(&probe_once, probe_init);
+  int ms = (p->deadline_ms >= 0) ? p->deadline_ms : probe_default_deadline;
+
+  pthread_mutex_lock(&probe_lock);
+  clock_gettime(CLOCK_MONOTONIC, &p->deadline);
+  p->deadline.tv_sec += ms / 1000;
+  p->deadline.tv_nsec += (ms % 1000) * 1000000L;
+  if (p->deadline.tv_nsec >= 1000000000L) {
+    p->deadline.tv_sec++;
+    p->deadline.tv_nsec -= 1000000000L;
+  }
+  p->abandoned = 0;
+  if (p->running || p->done) {
+    // still stuck from an earlier pass (or not collected yet), don't pile up
+    // another thread behind it.
+    pthread_mutex_unlock(&probe_lock);
+    return;
+  }
+  p->running = 1;
+
+  pthread_t thread;
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+  int e = pthread_create(&thread, &attr, probe_thread, p);
+  pthread_attr_destroy(&attr);
+  pthread_mutex_unlock(&probe_lock);
+  if (e != 0) {
+    probe_thread(p); // no threads available, run it inline
+  }
+}
+
+void probe_start_all(void) {
+  for (int i = 0; i < PROBE_COUNT; i++) {
+    if (probes[i].fn != NULL) {
+      probe_start(&probes[i]);
+    }
+  }
+}
+
+// returns 0 and hands over the probe's result (which may be NULL), or -1 if
+// the probe missed its deadline.
+int probe_wait(struct tinyprobe *p, char **result) {
+  if (p->fn == NULL) {
+    (*result) = NULL;
+    return 0;
+  }
+  pthread_mutex_lock(&probe_lock);
+  if (!p->running && !p->done) {
+    pthread_mutex_unlock(&probe_lock);
+    probe_start(p);
+    pthread_mutex_lock(&probe_lock);
+  }
+  int ms = (p->deadline_ms >= 0) ? p->deadline_ms : probe_default_deadline;
+  while (p->running && !p->done) {
+    if (ms == 0) {
+      pthread_cond_wait(&probe_cond, &probe_lock);
+    } else if (pthread_cond_timedwait(&probe_cond, &probe_lock,
+                                      &p->deadline) == ETIMEDOUT) {
+      break;
+    }
+  }
+
+  int ret = 0;
+  if (p->done) {
+    (*result) = p->result;
+    p->result = NULL;
+    p->done = 0;
+  } else {
+    (*result) = NULL;
+    p->abandoned = 1;
+    ret = -1;
+  }
+  pthread_mutex_unlock(&probe_lock);
+  return ret;
+}
+
+// "--deadline 100" sets the default, "--deadline gpu=500" a single probe.
+// 0 waits forever.
+int probe_set_deadline(const char *spec) {
+  const char *eq = strchr(spec, '=');
+  const char *value = (eq != NULL) ? eq + 1 : spec;
+  if (!isdigit((unsigned char)value[0])) {
+    return -1;
+  }
+  int ms = atoi(value);
+  if (eq == NULL) {
+    probe_default_deadline = ms;
+    for (int i = 0; i < PROBE_COUNT; i++) {
+      probes[i].deadline_ms = -1;
+    }
+    return 0;
+  }
+#if ENABLE_DISK && defined(__linux__)
+  if (eq - spec == 4 && !strncmp(spec, "disk", 4)) {
+    disk_deadline = ms; // applies to each mount on its own
+    return 0;
+  }
+#endif
+  for (int i = 0; i < PROBE_COUNT; i++) {
+    if (probes[i].name != NULL && strlen(probes[i].name) == (size_t)(eq - spec) &&
+        !strncmp(probes[i].name, spec, eq - spec)) {
+      probes[i].deadline_ms = ms;
+      return 0;
+    }
+  }
+  return -1;
+}
+
+#if ENABLE_USER
+char *probe_user(void *arg) {
+  (void)arg;
+  return get_username();
+}
+#endif
+
+#if ENABLE_DISTRO
+char *probe_distro(void *arg) {
+  (void)arg;
+  char *distro_name = get_distro_name();
+  char *distro_ver = get_distro_version();
+  char distro[512];
+  distro_string(distro, sizeof(distro), distro_name, distro_ver);
+  free(distro_name);
+  free(distro_ver);
+  return strdup(distro);
+}
+#endif
+
+#if ENABLE_SHELL
+char *probe_shell(void *arg) {
+  (void)arg;
+#ifdef __linux__
+  return get_parent_shell();
+#endif
+#if defined(__FreeBSD__) || defined(__MacOS__) || defined(__NetBSD__)
+  return get_parent_shell_noproc();
+#endif
+}
+#endif
+
+#if ENABLE_CPU
+char *probe_cpu(void *arg) {
+  (void)arg;
+  char line[512];
+  char *cpu = get_cpu_model();
+  int cpu_count = get_cpu_count();
+#ifdef __linux__
+  if (cpu == NULL) {
+    return NULL;
+  }
+  const char *freq_path =
+      "/sys/devices/system/cpu/cpufreq/policy0/scaling_available_frequencies";
+  double cpu_freq = (access(freq_path, R_OK) == 0)
+                        ? file_parser_double(freq_path, "%lf")
+                        : -1.0; // VMs usually have no cpufreq
+  if (cpu_freq > 0) {
+    snprintf(line, sizeof(line), "%s (%d) @ %.2fGHz", cpu, cpu_count,
+             cpu_freq / 1000000);
+  } else {
+    snprintf(line, sizeof(line), "%s (%d)", cpu, cpu_count);
+  }
+#endif
+#if defined(__FreeBSD__) || defined(__MacOS__) || defined(__NetBSD__)
+  if (cpu != NULL) {
+    snprintf(line, sizeof(line), "%s (%d)", cpu, cpu_count);
+  } else {
+    struct utsname u; // tiny belongs to the printing thread
+    uname(&u);
+    snprintf(line, sizeof(line), "Unknown %s CPU (%d)", u.machine, cpu_count);
+  }
+#endif
+  free(cpu);
+  return strdup(line);
+}
+#endif
+
+#if PCI_DETECTION == 1
+char *probe_gpu(void *arg) {
+  (void)arg;
+  return get_gpu_name();
+}
+#endif
+
+/*
+    filesystem usage
+*/
+
+#if ENABLE_DISK && defined(__linux__)
+// every mountpoint ever seen keeps its node (and probe) for the life of the
+// process: a thread stuck in statvfs on a dead NFS server still points at
+// it, and the node stops a second thread being started behind the first.
+struct disk_mount *disk_mounts;
+// statvfs, or a stand-in the tests use to make a mount hang
+int (*disk_statvfs)(const char *path, struct statvfs *st) = statvfs;
+
+// "used/total unit (pct%)" like df, or NULL for filesystems with no blocks
+char *probe_disk(void *arg) {
+  struct disk_mount *m = arg;
+  struct statvfs st;
+  if (disk_statvfs(m->path, &st) != 0 || st.f_blocks == 0) {
+    return NULL;
+  }
+  double total = (double)st.f_blocks * st.f_frsize;
+  double used = (double)(st.f_blocks - st.f_bfree) * st.f_frsize;
+  double avail = (double)st.f_bavail * st.f_frsize;
+  const char *units[] = {"MiB", "GiB", "TiB", "PiB"};
+  int unit = 0;
+  double scale = 1048576.0;
+  while (total / scale >= 1024 && unit < 3) {
+    scale *= 1024;
+    unit++;
+  }
+  char line[64];
+  snprintf(line, sizeof(line), "%.1f/%.1f %s (%.0f%%)", used / scale,
+           total / scale, units[unit],
+           (used + avail > 0) ? 100.0 * used / (used + avail) : 0.0);
+  return strdup(line);
+}
+
+int disk_pseudo_fs(const char *fstype) {
+  const char *pseudo[] = {"proc",       "sysfs",       "devtmpfs",   "devpts",
+                          "tmpfs",      "ramfs",       "cgroup",     "cgroup2",
+                          "securityfs", "selinuxfs",   "debugfs",    "tracefs",
+                          "configfs",   "pstore",      "bpf",        "mqueue",
+                          "hugetlbfs",  "autofs",      "fusectl",    "nsfs",
+                          "binfmt_misc", "rpc_pipefs", "nfsd",       "efivarfs",
+                          "squashfs"};
+  for (size_t i = 0; i < sizeof(pseudo) / sizeof(pseudo[0]); i++) {
+    if (!strcmp(fstype, pseudo[i])) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// mountinfo escapes blanks and backslashes as \ooo
+void disk_unescape(char *s) {
+  char *out = s;
+  for (; *s != '\0'; s++) {
+    if (s[0] == '\\' && s[1] >= '0' && s[1] <= '3' && s[2] >= '0' &&
+        s[2] <= '7' && s[3] >= '0' && s[3] <= '7') {
+      *out++ = (s[1] - '0') * 64 + (s[2] - '0') * 8 + (s[3] - '0');
+      s += 3;
+    } else {
+      *out++ = *s;
+    }
+  }
+  *out = '\0';
+}
+
+struct disk_mount *disk_node(const char *path) {
+  struct disk_mount **tail = &disk_mounts;
+  for (struct disk_mount *m = disk_mounts; m != NULL; m = m->next) {
+    if (!strcmp(m->path, path)) {
+      return m;
+    }
+    tail = &m->next;
+  }
+  struct disk_mount *m = calloc(1, sizeof(*m));
+  if (m == NULL || (m->path = strdup(path)) == NULL) {
+    free(m);
+    return NULL;
+  }
+  m->probe.name = "disk";
+  m->probe.fn = probe_disk;
+  m->probe.arg = m;
+  (*tail) = m;
+  return m;
+}
+
+// the Disk line for the mounts listed in a /proc/<pid>/mountinfo
+void disk_line(const char *mountinfo) {
+  static char *buf;
+  static size_t cap;
+  static int passes;
+  if (file_read_all(AT_FDCWD, mountinfo, &buf, &cap, DISK_MOUNTINFO_MAX) <=
+      0) {
+    return;
+  }
+
+  // one pass over mountinfo starts a probe per real filesystem, in order
+  int pass_id = ++passes;
+  struct disk_mount *pass = NULL, **pass_tail = &pass;
+  for (char *line = buf; line != NULL && *line != '\0';) {
+    char *next = strchr(line, '\n');
+    if (next != NULL) {
+      *next++ = '\0';
+    }
+    // "id parent major:minor root mountpoint options [optional...] - fstype"
+    char *field[5];
+    char *save = NULL;
+    int n = 0;
+    for (char *tok = strtok_r(line, " ", &save); tok != NULL && n < 5;
+         tok = strtok_r(NULL, " ", &save)) {
+      field[n++] = tok;
+    }
+    char *fstype = NULL;
+    for (char *tok = strtok_r(NULL, " ", &save); tok != NULL;
+         tok = strtok_r(NULL, " ", &save)) {
+      if (!strcmp(tok, "-")) {
+        fstype = strtok_r(NULL, " ", &save);
+        break;
+      }
+    }
+    line = next;
+    if (n < 5 || fstype == NULL || disk_pseudo_fs(fstype)) {
+      continue;
+    }
+    disk_unescape(field[4]);
+
+    // bind mounts show the same device again, count it once
+    int duplicate = 0;
+    for (struct disk_mount *m = pass; m != NULL; m = m->pass_next) {
+      if (!strcmp(m->dev, field[2])) {
+        duplicate = 1;
+        break;
+      }
+    }
+    struct disk_mount *m = duplicate ? NULL : disk_node(field[4]);
+    if (m == NULL) {
+      continue;
+    }
+    snprintf(m->dev, sizeof(m->dev), "%s", field[2]);
+    if (m->pass == pass_id) {
+      continue; // mounted over, statvfs only ever sees the top one
+    }
+    m->pass = pass_id;
+    m->probe.deadline_ms = disk_deadline;
+    m->pass_next = NULL;
+    (*pass_tail) = m;
+    pass_tail = &m->pass_next;
+    probe_start(&m->probe);
+  }
+  if (pass == NULL) {
+    return;
+  }
+
+  pretext(pretext_disk);
+  int first = 1;
+  for (struct disk_mount *m = pass; m != NULL; m = m->pass_next) {
+    char *usage;
+    if (probe_wait(&m->probe, &usage) != 0) {
+      printf("%s%s unresponsive", first ? "" : ", ", m->path);
+    } else if (usage != NULL) {
+      printf("%s%s %s", first ? "" : ", ", m->path, usage);
+      free(usage);
+    } else {
+      continue;
+    }
+    first = 0;
+  }
+  printf("\n");
+}
+
+void tinydisk(void) { disk_line("/proc/self/mountinfo"); }
+#endif
+
+/*
+    main printing functions
+*/
+
+void pretext(const char *string) {
+  printf("%s", string);
+  fflush(stdout); // flush stdout, just in case.
+}
+
+void fetchinfo(char *structname) { printf("%s\n", structname); }
+
+void tinyinit(void) {
+  if (uname(&tiny) == -1) {
+    perror("uname");
+  }
+}
+
+#if ENABLE_RANDOM_STRINGS
+unsigned long generate_random_index(unsigned long *seed, int array_size) {
+  // Initialize the seed using /dev/urandom
+  int urandom = open("/dev/urandom", O_RDONLY);
+  if (urandom < 0) {
+    perror("Unable to open /dev/urandom");
+    exit(EXIT_FAILURE);
+  }
+  if (read(urandom, seed, sizeof(*seed)) < 0) {
+    perror("Unable to read from /dev/urandom");
+    close(urandom);
+    exit(EXIT_FAILURE);
+  }
+  close(urandom);
+
+  // Generate a random number using the LCG
+  *seed = (MULTIPLIER * (*seed) + INCREMENT) % MODULUS;
+
+  // Return a random index within the array size
+  return *seed % array_size;
+}
+
+void rand_string(void) {
+  if (rand_enable == 1) {
+    int num_strings = sizeof(strings) / sizeof(strings[0]);
+    unsigned long seed;
+    unsigned long n = generate_random_index(&seed, num_strings);
+    fflush(stdout);
+    printf("%s %s\n", decoration, strings[n]);
+  }
+}
+
+void tinygenie(void) {
+  rand_enable = 1;
+  rand_string();
+}
+
+#endif
+
 void trim_spaces(char *str) {
   int len = strlen(str);
   while (len > 0 && isspace(str[len - 1])) {
@@ -460,6 +4079,19 @@ int get_cpu_count(void) {
 #endif
 }
 
+#ifdef __linux__
+int get_swap_stats(long long *total, long long *used, long long *free_mem) {
+  struct tinymeminfo mi;
+  if (meminfo_read(&mi) != 0 || mi.swap_total == -1 || mi.swap_free == -1) {
+    return -1;
+  }
+  (*total) = mi.swap_total * 1024;
+  (*used) = (mi.swap_total - mi.swap_free) * 1024;
+  (*free_mem) = mi.swap_free * 1024;
+  return 0;
+}
+#endif
+
 #if defined(__NetBSD__)
 int get_swap_stats(long long *total, long long *used, long long *free_mem) {
   (*total) = -1;
@@ -511,6 +4143,7 @@ int get_swap_stats(long long *total, long long *used, long long *free) {
 #endif
 
 void tinyascii(void) {
+#if ENABLE_ASCII_ART
   if (ascii_enable == 1) {
 #ifdef __NetBSD__
     char *distro_name = strdup("NetBSD");
@@ -587,28 +4220,27 @@ void tinyascii(void) {
 
     free(distro_name);
   }
+#endif
 }
 
+#if ENABLE_USER
 void tinyuser(void) {
   tinyinit();
-  // char *user = getenv("USER");
-  char *buf;
-  buf = (char *)malloc(10 * sizeof(char));
-  buf = getlogin();
-  char *user = buf;
-  printf("%s@", user); // username@, username is taken from char* user
-  if (user != NULL) {
-    int total_length = strlen(user) + strlen(tiny.nodename) + 1;
-    printf("%s\n", tiny.nodename);
-    for (int i = 0; i < total_length; i++) {
-      printf("-");
-    }
-    printf("\n");
-  } else {
-    perror("strlen");
+  char *user;
+  if (probe_wait(&probes[PROBE_USER], &user) != 0 || user == NULL) {
+    user = strdup("?");
+  }
+  printf("%s@%s\n", user, tiny.nodename); // username@hostname
+  int total_length = strlen(user) + strlen(tiny.nodename) + 1;
+  for (int i = 0; i < total_length; i++) {
+    printf("-");
   }
+  printf("\n");
+  free(user);
 }
+#endif
 
+#if ENABLE_OS
 void tinyos(void) {
   tinyinit();
   if (ascii_enable == 1)
@@ -621,46 +4253,25 @@ void tinyos(void) {
   }
   fetchinfo(tiny.sysname); // OS name
 }
+#endif
 
+#if ENABLE_DISTRO
 void tinydist(void) {
   if (ascii_enable == 1)
     printf("%s", tinyascii_p2);
   pretext(pretext_distro);
-#ifdef __NetBSD__
-  char *distro_name = strdup("NetBSD");
-#else
-  char *distro_name = file_parser_char("/etc/os-release", "NAME=%s");
-  int len = strlen(distro_name);
-  if (distro_name[0] == '"') {
-    memmove(distro_name, distro_name + 1, len - 1);
-    len--;
-  }
-  if (len > 0 && distro_name[len - 1] == '"') {
-    distro_name[len - 1] = '\0';
-  }
-#endif
-#ifdef __NetBSD__
-  char *distro_ver = NULL;
-#else
-  char *distro_ver =
-      file_parser_char("/etc/os-release", "VERSION_ID=\"%[^\"]\"%*c");
-#endif
-  if (distro_name == NULL) {
-    distro_name = "Generic Linux";
-  }
-  if (distro_ver == NULL) {
-    tinyinit();
-    printf("%s %s \n", distro_name, tiny.machine);
-    free(distro_name);
-    free(distro_ver);
+  char *distro;
+  if (probe_wait(&probes[PROBE_DISTRO], &distro) != 0) {
+    printf("%s\n", probe_timed_out);
     return;
   }
   tinyinit();
-  printf("%s %s %s \n", distro_name, distro_ver, tiny.machine);
-  free(distro_name);
-  free(distro_ver);
+  printf("%s %s \n", distro, tiny.machine);
+  free(distro);
 }
+#endif
 
+#if ENABLE_KERNEL
 void tinykern(void) {
   tinyinit();
   if (ascii_enable == 1)
@@ -668,21 +4279,24 @@ void tinykern(void) {
   pretext(pretext_kernel);
   fetchinfo(tiny.release); // gets kernel name
 }
+#endif
 
+#if ENABLE_SHELL
 void tinyshell(void) {
   if (ascii_enable == 1)
     printf("%s", tinyascii_p4);
   pretext(pretext_shell);
-#ifdef __linux__
-  char *shell = get_parent_shell();
-#endif
-#if defined(__FreeBSD__) || defined(__MacOS__) || defined(__NetBSD__)
-  char *shell = get_parent_shell_noproc();
-#endif
+  char *shell;
+  if (probe_wait(&probes[PROBE_SHELL], &shell) != 0) {
+    printf("%s\n", probe_timed_out);
+    return;
+  }
   printf("%s\n", shell);
   free(shell);
 }
+#endif
 
+#if ENABLE_UPTIME
 void tinyuptime(void) {
 #ifdef __linux__
   long int uptime = get_uptime();
@@ -699,7 +4313,9 @@ void tinyuptime(void) {
     format_uptime(uptime);
   }
 }
+#endif
 
+#if ENABLE_WM
 void tinywm(void) {
   char *wm = getenv("XDG_CURRENT_DESKTOP");
   if (wm != NULL) {
@@ -710,7 +4326,9 @@ void tinywm(void) {
     printf("%s\n", wm); // wm variable taken from getenv()
   }
 }
+#endif
 
+#if ENABLE_RAM
 void tinyram(void) {
   if (ascii_enable == 1) {
     char *wm = getenv("XDG_CURRENT_DESKTOP");
@@ -722,14 +4340,16 @@ void tinyram(void) {
   pretext(pretext_ram);
 #if defined(__linux__) || defined(__NetBSD__)
   // process memory used and total avail.
-  int memavail = file_parser("/proc/meminfo", "MemAvailable: %d kB");
-  int total_ram = file_parser("/proc/meminfo", "MemTotal: %d kB");
-  int ram_free = (memavail != -1)
-                     ? memavail
-                     : file_parser("/proc/meminfo", "MemFree: %d kB");
+  struct tinymeminfo mi;
+  if (meminfo_read(&mi) != 0) {
+    mi.mem_total = -1;
+  }
+  long long total_ram = mi.mem_total;
+  long long ram_free =
+      (mi.mem_available != -1) ? mi.mem_available : mi.mem_free;
 
   if (total_ram != -1 && ram_free != -1) {
-    int ram_used = total_ram - ram_free;
+    long long ram_used = total_ram - ram_free;
 
     // convert the values from /proc/meminfo into MiB double values
     double total_ram_mib = total_ram / 1024.0;
@@ -752,10 +4372,18 @@ void tinyram(void) {
 
     // print free RAM in MiB or GiB
     if (ram_free_mib < 1024) {
-      printf("%.2f MiB free)\n", ram_free_mib);
+      printf("%.2f MiB free)", ram_free_mib);
     } else {
-      printf("%.2f GiB free)\n", ram_free_mib / 1024.0);
+      printf("%.2f GiB free)", ram_free_mib / 1024.0);
     }
+#if ENABLE_HWPROBE && defined(__linux__)
+    struct hwprobe *hp = hwprobe_enable ? hwprobe_run() : NULL;
+    if (hp != NULL) {
+      printf(" [copy %.1f GB/s, triad %.1f GB/s]", hp->copy_gbs,
+             hp->triad_gbs);
+    }
+#endif
+    printf("\n");
   }
 #endif
 
@@ -800,61 +4428,59 @@ void tinyram(void) {
   }
 #endif
 }
+#endif
 
+#if ENABLE_CPU
 void tinycpu(void) {
-  tinyinit();
+  char *cpu;
+  int e = probe_wait(&probes[PROBE_CPU], &cpu);
+  if (e == 0 && cpu == NULL) {
+    return;
+  }
   if (ascii_enable == 1) {
     printf("%s", tinyascii_p8);
   }
   pretext(pretext_processor);
-#ifdef __linux__
-  char *cpu = file_parser_char("/proc/cpuinfo", "model name      : %[^\n]");
-  char *cpu_fallback = file_parser_char("/proc/cpuinfo", "cpu      : %[^\n]");
-  double cpu_freq = file_parser_double(
-      "/sys/devices/system/cpu/cpufreq/policy0/scaling_available_frequencies",
-      "%lf");
-  double formatted_freq = cpu_freq / 1000000;
-  int cpu_count = get_cpu_count();
-  if (cpu != NULL) {
-    printf("%s (%d) @ %.2fGHz\n", cpu, cpu_count, formatted_freq);
-    free(cpu);
-  } else if (cpu_fallback != NULL) {
-    printf("%s (%d)\n", cpu_fallback, cpu_count);
-    free(cpu_fallback);
+  printf("%s", (e == 0) ? cpu : probe_timed_out);
+  free(cpu);
+#if ENABLE_HWPROBE && defined(__linux__)
+  struct hwprobe *hp = hwprobe_enable ? hwprobe_run() : NULL;
+  if (hp != NULL) {
+    printf(" [%.0f Mops/s per core, slowest %.0f]", hp->core_avg,
+           hp->core_min);
   }
 #endif
-#if defined(__FreeBSD__) || defined(__MacOS__) || defined(__NetBSD__)
-#ifdef __NetBSD__
-  char *cpu = freebsd_sysctl_str("machdep.cpu_brand");
-  if (cpu == NULL)
-    cpu = freebsd_sysctl_str("hw.model");
-#else
-  char *cpu = freebsd_sysctl_str("hw.model");
+  printf("\n");
+}
 #endif
-  trim_spaces(cpu);
-  int cpu_count = get_cpu_count();
-  if (cpu != NULL) {
-    printf("%s (%d)\n", cpu, cpu_count);
-  } else {
-    printf("Unknown %s CPU (%d)\n", tiny.machine, cpu_count);
+#if ENABLE_CPU_USAGE && defined(__linux__)
+void tinycpuusage(void) {
+  struct cpu_usage usage;
+  if (get_cpu_usage(cpu_sample_ms, &usage) != 0) {
+    return;
   }
-#endif
+  pretext(pretext_cpu_usage);
+  printf("%.1f%% (busiest cpu%d %.1f%%, steal %.1f%%)\n", usage.total_pct,
+         usage.busiest_cpu, usage.busiest_pct, usage.steal_pct);
 }
+#endif
 #if defined(__linux__) || defined(__FreeBSD__) || defined(__NetBSD__)
 void tinygpu(void) {
 #if PCI_DETECTION == 1
-  char *gpu = get_gpu_name();
-  if (gpu != NULL) {
+  char *gpu;
+  int e = probe_wait(&probes[PROBE_GPU], &gpu);
+  if (e != 0 || gpu != NULL) {
     if (ascii_enable == 1) {
       printf("%s", tinyascii_p9);
     }
     pretext(pretext_gpu);
-    printf("%s\n", gpu);
+    printf("%s\n", (e == 0) ? gpu : probe_timed_out);
     free(gpu);
   }
 #endif
 }
 #endif
+#if ENABLE_SWAP
 void tinyswap(void) {
   if (get_swap_status() != 1) {
     return;
@@ -864,10 +4490,14 @@ void tinyswap(void) {
   }
   pretext(pretext_swap);
 #ifdef __linux__
-  int total_swap = file_parser("/proc/meminfo", "SwapTotal: %d kB");
-  int swap_free = file_parser("/proc/meminfo", "SwapFree: %d kB");
-  if (total_swap != 0 && swap_free != 0) {
-    int swap_used = total_swap - swap_free;
+  struct tinymeminfo mi;
+  if (meminfo_read(&mi) != 0) {
+    mi.swap_total = mi.swap_free = 0;
+  }
+  long long total_swap = mi.swap_total;
+  long long swap_free = mi.swap_free;
+  if (total_swap > 0 && swap_free >= 0) {
+    long long swap_used = total_swap - swap_free;
 
     // convert the values from /proc/meminfo into MiB double values
     double swap_total_mib = total_swap / 1024.0;
@@ -928,131 +4558,592 @@ void tinyswap(void) {
   }
 #endif
 }
+#endif
+
+/*
+    prometheus textfile output
+*/
+
+#if ENABLE_PROMETHEUS
+void prom_label(FILE *out, const char *name, const char *value, int first) {
+  fprintf(out, "%s%s=\"", first ? "" : ",", name);
+  for (const char *c = (value != NULL) ? value : ""; *c != '\0'; c++) {
+    if (*c == '\n') {
+      fputs("\\n", out);
+      continue;
+    }
+    if (*c == '\\' || *c == '"') {
+      fputc('\\', out);
+    }
+    fputc(*c, out);
+  }
+  fputc('"', out);
+}
+
+void prom_gauge(FILE *out, const char *name, const char *help,
+                long long value) {
+  fprintf(out, "# HELP %s %s\n# TYPE %s gauge\n%s %lld\n", name, help, name,
+          name, value);
+}
+
+int tinyprom(const char *path) {
+  // write next to the target and rename() over it, so the textfile collector
+  // never scrapes a half-written file. the suffix keeps it out of *.prom.
+  char tmp_path[PATH_MAX];
+  if (snprintf(tmp_path, sizeof(tmp_path), "%s.%d.tmp", path, (int)getpid()) >=
+      (int)sizeof(tmp_path)) {
+    printf("tinyfetch: prometheus path too long.\n");
+    return -1;
+  }
+  FILE *out = fopen(tmp_path, "w");
+  if (out == NULL) {
+    perror("fopen");
+    return -1;
+  }
+
+  tinyinit();
+  char os[sizeof(tiny.sysname) + 4];
+  snprintf(os, sizeof(os), "%s%s", strcmp(tiny.sysname, "Linux") ? "" : "GNU/",
+           tiny.sysname);
+  char *distro_name = get_distro_name();
+  char *distro_ver = get_distro_version();
+  char distro[512];
+  distro_string(distro, sizeof(distro), distro_name, distro_ver);
+  char *cpu = get_cpu_model();
+  char cpu_count[16];
+  snprintf(cpu_count, sizeof(cpu_count), "%d", get_cpu_count());
+  char *gpu;
+  probe_wait(&probes[PROBE_GPU], &gpu); // a wedged device leaves the label empty
+
+  fprintf(out, "# HELP tinyfetch_info System identity reported by tinyfetch.\n"
+               "# TYPE tinyfetch_info gauge\ntinyfetch_info{");
+  prom_label(out, "os", os, 1);
+  prom_label(out, "distro", distro, 0);
+  prom_label(out, "kernel", tiny.release, 0);
+  prom_label(out, "machine", tiny.machine, 0);
+  prom_label(out, "cpu", cpu, 0);
+  prom_label(out, "cpu_count", cpu_count, 0);
+  prom_label(out, "gpu", gpu, 0);
+  fprintf(out, "} 1\n");
+  free(distro_name);
+  free(distro_ver);
+  free(cpu);
+  free(gpu);
+
+#ifdef __linux__
+  long int uptime = get_uptime();
+#endif
+#if defined(__FreeBSD__) || defined(__MacOS__) || defined(__NetBSD__)
+  long int uptime = get_uptime_freebsd();
+#endif
+  if (uptime != -1) {
+    prom_gauge(out, "tinyfetch_uptime_seconds", "Seconds since boot.", uptime);
+  }
+
+  long long total, avail, used;
+  if (get_ram_stats(&total, &avail) == 0) {
+    prom_gauge(out, "tinyfetch_memory_total_bytes", "Total usable RAM.", total);
+    prom_gauge(out, "tinyfetch_memory_available_bytes",
+               "RAM available for new allocations.", avail);
+    prom_gauge(out, "tinyfetch_memory_used_bytes", "RAM in use.",
+               total - avail);
+  }
+  long long swap_free;
+  if (get_swap_stats(&total, &used, &swap_free) == 0) {
+    prom_gauge(out, "tinyfetch_swap_total_bytes", "Total swap space.", total);
+    prom_gauge(out, "tinyfetch_swap_free_bytes", "Unused swap space.",
+               swap_free);
+  }
+
+  if (ferror(out) | fclose(out)) {
+    perror("write");
+    unlink(tmp_path);
+    return -1;
+  }
+  if (rename(tmp_path, path) != 0) {
+    perror("rename");
+    unlink(tmp_path);
+    return -1;
+  }
+  return 0;
+}
+
+#endif
 
 void tinyfetch(char *msg) {
+  probe_start_all(); // collect in the background while the art is printed
   tinyascii();
-  tinyuser();
+#if ENABLE_USER
+  tinyrun("--user", tinyuser);
+#endif
+#if ENABLE_RANDOM_STRINGS
   rand_string();
+#endif
   message(msg);
-  tinyos();
-  tinydist();
-  tinykern();
-  tinyshell();
-  tinyuptime();
-  tinywm();
-  tinycpu();
-  tinygpu();
-  tinyram();
-  tinyswap();
-}
-
-int isValidArgument(char *arg) {
-  const char *validArgs[] = {"-v",
-                             "-h",
-                             "-m",
-                             "-r",
-                             "-o",
-                             "-d",
-                             "-k",
-                             "-s",
-                             "-u",
-                             "-w",
-                             "--ram",
-                             "-c",
-                             "--swap",
-                             "--genie",
-                             "--disable-ascii",
-                             "--user",
-                             "--custom-ascii",
-                             "-g"};
-  size_t numArgs = sizeof(validArgs) / sizeof(validArgs[0]);
-  for (size_t i = 0; i < numArgs; ++i) {
-    if (strcmp(arg, validArgs[i]) == 0) {
-      return 1;
+#if ENABLE_OS
+  tinyrun("-o", tinyos);
+#endif
+#if ENABLE_DISTRO
+  tinyrun("-d", tinydist);
+#endif
+#if ENABLE_KERNEL
+  tinyrun("-k", tinykern);
+#endif
+#if ENABLE_SHELL
+  tinyrun("-s", tinyshell);
+#endif
+#if ENABLE_UPTIME
+  tinyrun("-u", tinyuptime);
+#endif
+#if ENABLE_WM
+  tinyrun("-w", tinywm);
+#endif
+#if ENABLE_CPU
+  tinyrun("-c", tinycpu);
+#endif
+#if PCI_DETECTION == 1
+  tinyrun("-g", tinygpu);
+#endif
+#if ENABLE_RAM
+  tinyrun("--ram", tinyram);
+#endif
+#if ENABLE_SWAP
+  tinyrun("--swap", tinyswap);
+#endif
+#if ENABLE_CGROUP && defined(__linux__)
+  tinyrun("--cgroup", tinycgroup_limited);
+#endif
+}
+
+/*
+    self profiling
+*/
+
+#if ENABLE_PERF_STAT && defined(__linux__)
+// opens each counter of the calling thread on its own, so a VM without a
+// PMU still gets the software ones; returns why the first failure failed
+int perf_open_counters(int *fds) {
+  const struct {
+    unsigned int type;
+    unsigned long long config;
+  } events[PERF_COUNTERS] = {
+      {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+      {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+      {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+      {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+      {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES},
+  };
+  int error = 0;
+  for (int i = 0; i < PERF_COUNTERS; i++) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = events[i].type;
+    attr.config = events[i].config;
+    attr.exclude_hv = 1;
+    fds[i] = syscall(SYS_perf_event_open, &attr, 0, -1, -1,
+                     PERF_FLAG_FD_CLOEXEC);
+    if (fds[i] < 0 && (errno == EACCES || errno == EPERM)) {
+      attr.exclude_kernel = 1; // all perf_event_paranoid 2 allows
+      fds[i] = syscall(SYS_perf_event_open, &attr, 0, -1, -1,
+                       PERF_FLAG_FD_CLOEXEC);
+    }
+    if (fds[i] < 0 && error == 0) {
+      error = errno;
     }
   }
-  return 0;
+  return error;
 }
 
-int main(int argc, char *argv[]) {
-  if (argc == 1) {
-    ascii_enable = 1;
-    tinyfetch(NULL);
-    return 0;
+// the main thread's counters only: probe threads count themselves (see
+// probe_thread) and are reported on their own rows
+void perf_open(void) {
+  // startup (exec, the dynamic loader, libc init) is over before any
+  // counter can be opened, getrusage still has its faults and switches
+  struct rusage ru;
+  getrusage(RUSAGE_SELF, &ru);
+  perf_startup_faults = ru.ru_minflt + ru.ru_majflt;
+  perf_startup_switches = ru.ru_nvcsw + ru.ru_nivcsw;
+  perf_errno = perf_open_counters(perf_fds);
+}
+
+void perf_read(const int *fds, unsigned long long *values) {
+  for (int i = 0; i < PERF_COUNTERS; i++) {
+    if (fds[i] < 0 ||
+        read(fds[i], &values[i], sizeof(values[i])) != sizeof(values[i])) {
+      values[i] = 0;
+    }
+  }
+}
+
+void perf_print_count(int counter, unsigned long long value) {
+  if (perf_fds[counter] < 0) {
+    printf(" %10s", "-");
+  } else if (value < 100000) {
+    printf(" %10llu", value);
+  } else if (value < 100000000) {
+    printf(" %9.1fK", value / 1e3);
+  } else {
+    printf(" %9.1fM", value / 1e6);
   }
+}
 
-  if (argc > 1) {
-    if (!strcmp(argv[1], "--disable-ascii") && argc == 2) {
-      // If only "-d" is passed, print basic system information
-      tinyfetch(NULL);
-    } else if (!strcmp(argv[1], "--disable-ascii") && !strcmp(argv[2], "-r")) {
-      // If both "-d" and "-r" are passed, enable random string printing
-      rand_enable = 1;
-      tinyfetch(NULL);
+// prints and clears what the pass collected
+void perf_report(void) {
+  printf("\n%-16s %10s %10s %10s %10s %10s %10s\n", "perf-stat", "instr",
+         "cycles", "cache-miss", "faults", "ctx-sw", "ms");
+  printf("%-16s %10s %10s %10s %10lld %10lld %10s\n", "startup", "-", "-",
+         "-", perf_startup_faults, perf_startup_switches, "-");
+  for (int i = 0; i < perf_num_sections; i++) {
+    printf("%-16s", perf_sections[i].name);
+    for (int c = 0; c < PERF_COUNTERS; c++) {
+      perf_print_count(c, perf_sections[i].counts[c]);
     }
-    if (!strcmp(argv[1], "-v") || !strcmp(argv[1], "--version")) {
-      printf("%s v%s\n", argv[0], VERSION);
-      return 0;
-    } else if (!strcmp(argv[1], "-h") || !strcmp(argv[1], "--help")) {
-      printf("%s %s", decoration, help_banner);
-      return 0;
-    } else if (!strcmp(argv[1], "-m") || !strcmp(argv[1], "--message")) {
-      if (argc < 3) {
-        printf("no message provided.\n");
-        return 1;
+    printf(" %10.2f\n", perf_sections[i].ms);
+  }
+  // the probe threads, whichever pass they finished in; one that is still
+  // stuck has nothing to show yet
+  pthread_mutex_lock(&probe_lock);
+  for (int i = 0; i < PROBE_COUNT; i++) {
+    struct tinyprobe *p = &probes[i];
+    char name[32];
+    snprintf(name, sizeof(name), "%s probe", p->name);
+    if (p->fn != NULL && p->running && !p->perf_measured) {
+      printf("%-16s %s\n", name, "still running");
+    } else if (p->fn != NULL && p->perf_measured) {
+      printf("%-16s", name);
+      for (int c = 0; c < PERF_COUNTERS; c++) {
+        perf_print_count(c, p->perf_counts[c]);
       }
-      ascii_enable = 1;
-      custom_message = 1;
-      tinyfetch(argv[2]);
-      return 0;
-    } else if (!strcmp(argv[1], "-r") || !strcmp(argv[1], "--random")) {
-      ascii_enable = 1;
-      rand_enable = 1;
-      tinyfetch(NULL);
-    } else if (!strcmp(argv[1], "-o")) {
-      tinyos();
-    } else if (!strcmp(argv[1], "-d")) {
-      tinydist();
-    } else if (!strcmp(argv[1], "-k")) {
-      tinykern();
-    } else if (!strcmp(argv[1], "-s")) {
-      tinyshell();
-    } else if (!strcmp(argv[1], "-u")) {
-      tinyuptime();
-    } else if (!strcmp(argv[1], "-w")) {
-      tinywm();
-    } else if (!strcmp(argv[1], "--ram")) {
-      tinyram();
-    } else if (!strcmp(argv[1], "-c")) {
-      tinycpu();
-    } else if (!strcmp(argv[1], "--swap")) {
-      tinyswap();
-    } else if (!strcmp(argv[1], "--genie")) {
-      rand_enable = 1;
-      rand_string();
-    } else if (!strcmp(argv[1], "--user")) {
-      tinyuser();
-    } else if (!strcmp(argv[1], "-g")) {
-      tinygpu();
-    }
-
-    if (argc == 2) {
-      if (!isValidArgument(argv[1])) {
-        printf("tinyfetch: Unknown command line argument.\n %s %s", decoration,
-               help_banner);
-        return 1;
+      printf(" %10.2f\n", p->perf_ms);
+      p->perf_measured = 0;
+    }
+  }
+  pthread_mutex_unlock(&probe_lock);
+  // no PMU (most VMs) is not a permission problem, only EACCES/EPERM is
+  // worth pointing at perf_event_paranoid for
+  if (perf_errno == ENOENT || perf_errno == EOPNOTSUPP ||
+      perf_errno == ENODEV) {
+    printf("hardware counters not supported\n");
+  } else if (perf_errno == EACCES || perf_errno == EPERM) {
+    char buf[16];
+    int paranoid = 0;
+    if (file_read_at(AT_FDCWD, "/proc/sys/kernel/perf_event_paranoid", buf,
+                     sizeof(buf)) > 0) {
+      paranoid = atoi(buf);
+    }
+    printf("some counters are unavailable: %s (perf_event_paranoid=%d)\n",
+           strerror(perf_errno), paranoid);
+  } else if (perf_errno != 0) {
+    printf("some counters are unavailable: %s\n", strerror(perf_errno));
+  }
+  perf_num_sections = 0;
+  perf_startup_faults = perf_startup_switches = 0; // only the first pass
+}
+#endif
+
+// every collector runs through here, so it can be measured and traced
+void tinyrun(const char *name, void (*fn)(void)) {
+  TINY_PROBE1(collector__entry, name);
+#if ENABLE_PERF_STAT && defined(__linux__)
+  if (perf_enable && perf_num_sections < PERF_MAX_SECTIONS) {
+    unsigned long long before[PERF_COUNTERS], after[PERF_COUNTERS];
+    struct timespec start, end;
+    perf_read(perf_fds, before);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    fn();
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    perf_read(perf_fds, after);
+    fflush(stdout); // keep the report behind the fetch itself
+
+    struct perf_section *section = &perf_sections[perf_num_sections++];
+    section->name = name;
+    for (int i = 0; i < PERF_COUNTERS; i++) {
+      section->counts[i] = after[i] - before[i];
+    }
+    section->ms = (end.tv_sec - start.tv_sec) * 1e3 +
+                  (end.tv_nsec - start.tv_nsec) / 1e6;
+  } else {
+    fn();
+  }
+#else
+  fn();
+#endif
+  TINY_PROBE1(collector__return, name);
+}
+
+/*
+    command line handling
+*/
+
+// single-field flags, built from whatever collectors were compiled in
+const struct tinycmd tinycmds[] = {
+#if ENABLE_OS
+    {"-o", tinyos},
+#endif
+#if ENABLE_DISTRO
+    {"-d", tinydist},
+#endif
+#if ENABLE_KERNEL
+    {"-k", tinykern},
+#endif
+#if ENABLE_MITIGATIONS && defined(__linux__)
+    {"--mitigations", tinymitigations},
+    {"--mitigations-verbose", tinymitigations_verbose},
+#endif
+#if ENABLE_SHELL
+    {"-s", tinyshell},
+#endif
+#if ENABLE_UPTIME
+    {"-u", tinyuptime},
+#endif
+#if ENABLE_WM
+    {"-w", tinywm},
+#endif
+#if ENABLE_CPU
+    {"-c", tinycpu},
+#endif
+#if PCI_DETECTION == 1
+    {"-g", tinygpu},
+#endif
+#if ENABLE_CPU_USAGE && defined(__linux__)
+    {"--cpu-usage", tinycpuusage},
+#endif
+#if ENABLE_NUMA && defined(__linux__)
+    {"--numa", tinynuma},
+#endif
+#if ENABLE_TOPOLOGY && defined(__linux__)
+    {"--topology", tinytopology},
+#endif
+#if ENABLE_ISA && (defined(__x86_64__) || defined(__i386__) ||               \
+                   (defined(__aarch64__) && defined(__linux__)))
+    {"--isa", tinyisa},
+#endif
+#if ENABLE_PRESSURE && defined(__linux__)
+    {"--pressure", tinypressure},
+#endif
+#if ENABLE_CGROUP && defined(__linux__)
+    {"--cgroup", tinycgroup},
+#endif
+#if ENABLE_TOP && defined(__linux__)
+    {"--top", tinytop},
+#endif
+#if ENABLE_IRQ && defined(__linux__)
+    {"--irq", tinyirq},
+#endif
+#if ENABLE_STORAGE && defined(__linux__)
+    {"--storage", tinystorage},
+#endif
+#if ENABLE_DISK && defined(__linux__)
+    {"--disk", tinydisk},
+#endif
+#if ENABLE_NET && defined(__linux__)
+    {"--net", tinynet},
+#endif
+#if ENABLE_THERMAL && defined(__linux__)
+    {"--thermal", tinythermal},
+#endif
+#if ENABLE_TUNING && defined(__linux__)
+    {"--tuning", tinytuning},
+#endif
+#if ENABLE_LATENCY && defined(__linux__)
+    {"--latency", tinylatency},
+#endif
+#if ENABLE_RAM
+    {"--ram", tinyram},
+#endif
+#if ENABLE_HUGEPAGES && defined(__linux__)
+    {"--hugepages", tinyhugepages},
+#endif
+#if ENABLE_SWAP
+    {"--swap", tinyswap},
+#endif
+#if ENABLE_USER
+    {"--user", tinyuser},
+#endif
+#if ENABLE_RANDOM_STRINGS
+    {"--genie", tinygenie},
+#endif
+    {NULL, NULL}};
+
+const struct tinycmd *find_command(const char *arg) {
+  for (const struct tinycmd *cmd = tinycmds; cmd->flag != NULL; cmd++) {
+    if (!strcmp(arg, cmd->flag)) {
+      return cmd;
+    }
+  }
+  return NULL;
+}
+
+// strips the options that apply to every mode out of argv and returns the
+// remaining argc, or -1 if one of them is malformed.
+int parse_global_options(int argc, char *argv[]) {
+  int kept = 1;
+  for (int i = 1; i < argc; i++) {
+#if ENABLE_PROMETHEUS
+    if (!strcmp(argv[i], "--prometheus")) {
+      if (i + 1 >= argc) {
+        printf("tinyfetch: --prometheus requires a path.\n");
+        return -1;
+      }
+      prom_path = argv[++i];
+      continue;
+    }
+#endif
+    if (!strcmp(argv[i], "--sample-ms")) {
+      if (i + 1 >= argc || (cpu_sample_ms = atoi(argv[i + 1])) <= 0) {
+        printf("tinyfetch: --sample-ms requires a number of milliseconds.\n");
+        return -1;
+      }
+      i++;
+    } else if (!strcmp(argv[i], "--interval")) {
+      if (i + 1 >= argc || (fetch_interval = atoi(argv[i + 1])) <= 0) {
+        printf("tinyfetch: --interval requires a number of seconds.\n");
+        return -1;
+      }
+      i++;
+#if ENABLE_USER
+    } else if (!strcmp(argv[i], "--nss")) {
+      nss_enable = 1;
+#endif
+#if ENABLE_TOP && defined(__linux__)
+    } else if (!strcmp(argv[i], "--top")) {
+      // the count is consumed here, the flag stays to keep its position
+      if (i + 1 >= argc || (top_count = atoi(argv[i + 1])) <= 0 ||
+          top_count > TOP_MAX) {
+        printf("tinyfetch: --top requires a count from 1 to %d.\n", TOP_MAX);
+        return -1;
+      }
+      argv[kept++] = argv[i++];
+#endif
+#if ENABLE_HWPROBE && defined(__linux__)
+    } else if (!strcmp(argv[i], "--probe")) {
+      hwprobe_enable = 1;
+#endif
+#if ENABLE_BATCH && defined(__linux__)
+    } else if (!strcmp(argv[i], "--batch")) {
+      if (i + 1 >= argc) {
+        printf("tinyfetch: --batch requires a directory of snapshots.\n");
+        return -1;
+      }
+      batch_dir = argv[++i];
+#endif
+#if ENABLE_PERF_STAT && defined(__linux__)
+    } else if (!strcmp(argv[i], "--perf-stat")) {
+      perf_enable = 1;
+#endif
+#if ENABLE_TUNING && defined(__linux__)
+    } else if (!strcmp(argv[i], "--tuning-baseline")) {
+      if (i + 1 >= argc) {
+        printf("tinyfetch: --tuning-baseline requires a path.\n");
+        return -1;
       }
-    } else if (argc == 3) {
-      if (!isValidArgument(argv[2])) {
-        printf("tinyfetch: Unknown command line argument.\n %s %s", decoration,
-               help_banner);
-        return 1;
+      tuning_baseline = argv[++i];
+#endif
+    } else if (!strcmp(argv[i], "--deadline")) {
+      if (i + 1 >= argc || probe_set_deadline(argv[i + 1]) != 0) {
+        printf("tinyfetch: --deadline requires [probe=]milliseconds.\n");
+        return -1;
       }
+      i++;
+    } else {
+      argv[kept++] = argv[i];
     }
+  }
+  argv[kept] = NULL;
+  return kept;
+}
 
-  } else {
-    printf("tinyfetch: Unknown command line argument.\n %s %s", decoration,
-           help_banner);
+int main(int argc, char *argv[]) {
+  argc = parse_global_options(argc, argv);
+  if (argc < 0) {
+    return 1;
+  }
+#if ENABLE_BATCH && defined(__linux__)
+  if (batch_dir != NULL) {
+    return tinybatch(batch_dir);
+  }
+#endif
+#if ENABLE_PERF_STAT && defined(__linux__)
+  if (perf_enable) {
+    perf_open();
+  }
+#endif
+
+  // with --interval, one resident process keeps re-running the same fetch
+  // (and rewriting the prometheus file) instead of being forked by cron.
+  for (;;) {
+    int ret = 0;
+#if ENABLE_PROMETHEUS
+    if (prom_path != NULL && tinyprom(prom_path) != 0) {
+      ret = 1;
+    }
+#endif
+    if (prom_path == NULL || argc > 1) {
+      ret |= tinymain(argc, argv);
+    }
+#if ENABLE_PERF_STAT && defined(__linux__)
+    if (perf_enable) {
+      perf_report();
+    }
+#endif
+    if (fetch_interval <= 0) {
+      return ret;
+    }
+    fflush(stdout);
+    sleep(fetch_interval);
+  }
+}
+
+int tinymain(int argc, char *argv[]) {
+  if (argc == 1) {
+    ascii_enable = ENABLE_ASCII_ART;
+    tinyfetch(NULL);
+    return 0;
+  }
+
+  if (!strcmp(argv[1], "--disable-ascii")) {
+#if ENABLE_RANDOM_STRINGS
+    // "--disable-ascii -r" also prints a random string
+    rand_enable = (argc > 2 && !strcmp(argv[2], "-r"));
+#endif
+    tinyfetch(NULL);
+    return 0;
+  } else if (!strcmp(argv[1], "-v") || !strcmp(argv[1], "--version")) {
+    printf("%s v%s\n", argv[0], VERSION);
+    return 0;
+  } else if (!strcmp(argv[1], "-h") || !strcmp(argv[1], "--help")) {
+    printf("%s %s", decoration, help_banner);
+    return 0;
+  } else if (!strcmp(argv[1], "-m") || !strcmp(argv[1], "--message")) {
+    if (argc < 3) {
+      printf("no message provided.\n");
+      return 1;
+    }
+    ascii_enable = ENABLE_ASCII_ART;
+    custom_message = 1;
+    tinyfetch(argv[2]);
+    return 0;
+#if ENABLE_RANDOM_STRINGS
+  } else if (!strcmp(argv[1], "-r") || !strcmp(argv[1], "--random")) {
+    ascii_enable = ENABLE_ASCII_ART;
+    rand_enable = 1;
+    tinyfetch(NULL);
+    return 0;
+#endif
+  }
+
+  // anything else is a list of single fields, printed in the order given
+  for (int i = 1; i < argc; i++) {
+    if (find_command(argv[i]) == NULL) {
+      printf("tinyfetch: Unknown command line argument.\n %s %s", decoration,
+             help_banner);
+      return 1;
+    }
+  }
+  for (int i = 1; i < argc; i++) {
+    const struct tinycmd *cmd = find_command(argv[i]);
+    tinyrun(cmd->flag, cmd->fn);
   }
   return 0;
 }
@@ -8,14 +8,57 @@
 */
 #define VERSION "6.3"
 #define decoration "[·]"
-#define CMDLINE_PATH "/proc/%d/cmdline"
+#define STAT_PATH "/proc/%d/stat"
+#define SHELL_SEARCH_DEPTH 16
+#if ENABLE_HELP_TEXT
 #define help_banner                                                            \
   "tinyfetch help\n -v or --version\
         print the installed version of tinyfetch\n -h or --help        \
 	print this help banner\n -m or --message     \
 	add a custom message at the end of arguments\n \
 -r or --random         add a random message before the fetch\n\
- --disable-ascii        disable ascii art"
+ --disable-ascii        disable ascii art\n\
+ --prometheus <path>    write node_exporter textfile metrics to path\n\
+ --interval <seconds>   keep running and refresh every interval\n\
+ --deadline [probe=]ms  give up on slow sources (user, distro, shell, cpu,\n\
+                        gpu) after ms milliseconds, 0 waits forever\n\
+ --nss                  resolve the user name through NSS (may hit LDAP)\n\
+ --probe                add STREAM memory bandwidth to the RAM line and a\n\
+                        per-core throughput score to the CPU line (~200 ms)\n\
+ --perf-stat            after the fetch, print instructions, cycles, cache\n\
+                        misses, page faults and switches per field\n\
+ --batch <dir>          render every snapshot directory in dir (meminfo,\n\
+                        cpuinfo, os-release, uname -snrm) as JSON lines\n\
+ -o -d -k -s -u -w -c -g --ram --swap --user --genie\n\
+                        print only the given fields, in order\n\
+ --mitigations          how many CPU vulnerabilities are mitigated, how\n\
+                        many of those costly, and how many are not;\n\
+                        --mitigations-verbose lists each one\n\
+ --cpu-usage            sample CPU utilization over --sample-ms (200)\n\
+ --numa                 NUMA node count and free memory per node\n\
+ --topology             sockets, cores, SMT and the cache hierarchy\n\
+ --isa                  vector and crypto extensions, straight from cpuid\n\
+ --hugepages            transparent hugepage mode and the hugetlb pool\n\
+ --pressure             stall time over the last 10s (some, full if any)\n\
+ --cgroup               cgroup v2 CPU and memory limits, also shown in the\n\
+                        full fetch whenever a limit is set\n\
+ --top <n>              the n processes using the most memory (RSS)\n\
+ --irq                  busiest interrupt sources and the share of each\n\
+                        handled by a single CPU\n\
+ --storage              block devices with size, model, type and the\n\
+                        scheduler/queue depth\n\
+ --disk                 usage of every real filesystem, \"unresponsive\" when\n\
+                        statvfs misses its deadline (--deadline disk=ms)\n\
+ --net                  interfaces that are up, with address, MTU, speed\n\
+                        and queue counts\n\
+ --thermal              package and core temperatures, flags throttling\n\
+ --tuning               sysctls that differ from the kernel defaults, or\n\
+                        from --tuning-baseline <sysctl.conf>\n\
+ --latency              isolated and tickless CPUs (flagged when they don't\n\
+                        match the command line) and the clocksource\n"
+#else
+#define help_banner "help text was not compiled in\n"
+#endif
 #define pretext_OS "OS:         "
 #define pretext_distro "Distro:     "
 #define pretext_kernel "Kernel:     "
@@ -26,6 +69,60 @@
 #define pretext_gpu "GPU:        "
 #define pretext_ram "RAM:        "
 #define pretext_swap "Swap:       "
+#define pretext_cpu_usage "CPU Usage:  "
+#define pretext_numa "NUMA:       "
+#define NUMA_MAX_NODES 1024
+#define pretext_topology "Topology:   "
+#define pretext_isa "ISA:        "
+#define pretext_hugepages "Hugepages:  "
+#define pretext_pressure "Pressure:   "
+#define pretext_cgroup "Cgroup:     "
+#define CGROUP_SELF "/proc/self/cgroup"
+#define CGROUP_ROOT "/sys/fs/cgroup"
+#define pretext_top "Top RSS:    "
+#define TOP_MAX 100
+#define TOP_MAX_THREADS 8
+#define TOP_THREAD_PIDS 4096
+#define pretext_irq "IRQ:        "
+#define IRQ_TOP 5
+#define IRQ_CHUNK 65536
+#define IRQ_BUF_SIZE (4 * IRQ_CHUNK) // one row per CPU column fits ~20k CPUs
+#define pretext_storage "Storage:    "
+#define STORAGE_SHOWN 8
+#define pretext_disk "Disk:       "
+#define DISK_MOUNTINFO_MAX (16 << 20)
+#define pretext_net "Net:        "
+#define NET_SHOWN 8
+#define NET_BUF_SIZE 32768
+#define pretext_thermal "Thermal:    "
+#define THERMAL_HWMON "/sys/class/hwmon"
+#define THERMAL_CPU "/sys/devices/system/cpu"
+#define THERMAL_MAX_INPUTS 256 // per hwmon device
+#define THERMAL_MAX_SENSORS 512
+#define pretext_mitigations "Mitigation: "
+#define VULN_MAX 64
+#define pretext_tuning "Tuning:     "
+#define TUNING_KNOBS (sizeof(tuning_knobs) / sizeof(tuning_knobs[0]))
+#define TUNING_BASELINE_MAX (1 << 20)
+#define pretext_latency "Latency:    "
+#define LATENCY_LIST_SIZE 1024
+#define HWPROBE_MAX_THREADS 1024
+#define HWPROBE_MIN_BYTES (96 << 20) // all STREAM arrays together, at least
+#define HWPROBE_MAX_BYTES (128 << 20) // and at most
+#define HWPROBE_MIN_ARRAY (64 << 10)  // per worker
+#define HWPROBE_BUDGET_MS 80 // for the STREAM passes, and again for the cores
+#define HWPROBE_REPS 3       // at most
+#define HWPROBE_CORE_ITERS 5000000 // at most
+#define HWPROBE_CORE_CHUNK 100000  // between clock checks
+#define PERF_COUNTERS 5
+#define PERF_MAX_SECTIONS 64
+#define BATCH_MAX_WORKERS 256
+#define BATCH_FILE_MAX (64 << 20) // a snapshot file, cpuinfo is the big one
+#define CPUSET_BITS 8192
+#define CPUSET_WORDS (CPUSET_BITS / 64)
+#define CPUSET_SET(set, cpu) ((set)[(cpu) / 64] |= 1ULL << ((cpu) % 64))
+#define CPUSET_ISSET(set, cpu) (((set)[(cpu) / 64] >> ((cpu) % 64)) & 1)
+#define probe_timed_out "timed out"
 
 /*
     environment variables
@@ -33,12 +130,25 @@
 
 int rand_enable;
 int custom_message;
+char *prom_path;
+int fetch_interval;
+int probe_default_deadline = 50; // milliseconds
+int nss_enable;
+int cpu_sample_ms = 200;
+int top_count;
+int disk_deadline = -1; // per mount, -1 uses probe_default_deadline
+char *tuning_baseline;
+int hwprobe_enable;
+int perf_enable;
+char *batch_dir;
+char *username_cache;
 struct utsname tiny;
 
 #define MODULUS 2147483648 // 2^31
 #define MULTIPLIER 1103515245
 #define INCREMENT 12345
 
+#if ENABLE_RANDOM_STRINGS
 const char *strings[] = {
     "uhhhhhh",
     "hmmmmmm",
@@ -108,6 +218,31 @@ const char *strings[] = {
     "argc is a array, its index starts at 0",
     "system(\"uname -o\")",
     "Fully ported to FreeBSD!"};
+#endif
+#if ENABLE_TUNING
+// sysctls behind most "this node is slower" reports, with the kernel's own
+// defaults as the baseline; --tuning-baseline replaces them
+struct tuning_knob {
+  const char *name;
+  const char *baseline; // NULL: depends on the hardware
+} tuning_knobs[] = {
+    {"vm.swappiness", "60"},
+    {"vm.dirty_ratio", "20"},
+    {"vm.dirty_background_ratio", "10"},
+    {"vm.overcommit_memory", "0"},
+    {"vm.zone_reclaim_mode", "0"},
+    {"kernel.numa_balancing", NULL},
+    {"kernel.sched_autogroup_enabled", "1"},
+    {"net.core.somaxconn", "4096"},
+};
+#endif
+// process names that end the walk up the process tree in get_parent_shell()
+const char *known_shells[] = {"sh",     "bash",  "dash",  "zsh",  "fish",
+                              "ksh",    "mksh",  "oksh",  "loksh", "pdksh",
+                              "tcsh",   "csh",   "yash",  "ash",   "nu",
+                              "elvish", "xonsh", "ion",   "osh",   "ysh",
+                              "pwsh",   "rc",    "es"};
+
 /*
         function protypes
 */
@@ -116,10 +251,35 @@ const char *strings[] = {
 int file_parser(const char *file, const char *line_to_read);
 double file_parser_double(const char *file, const char *line_to_read);
 char *file_parser_char(const char *file, const char *line_to_read);
+unsigned long long parse_ull(char **p);
+int cpulist_parse(char *list, unsigned long long *set, int nbits);
+ssize_t file_read_at(int dirfd, const char *path, char *buf, size_t size);
+ssize_t file_read_all(int dirfd, const char *path, char **buf, size_t *cap,
+                      size_t max);
+
+// /proc/meminfo
+struct tinymeminfo {
+  long long mem_total;
+  long long mem_free;
+  long long mem_available;
+  long long swap_total;
+  long long swap_free;
+  long long anon_hugepages;
+  long long hugepages_total;
+  long long hugepages_free;
+  long long hugepagesize;
+};
+void meminfo_parse(char *buf, struct tinymeminfo *mi);
+int meminfo_read(struct tinymeminfo *mi);
 
 // hostname handling
 char *get_hostname(void);
 
+// user identity
+char *passwd_name(uid_t uid);
+char *resolve_username(void);
+char *get_username(void);
+
 // FreeBSD sysctl calling
 #ifdef __FreeBSD__
 char *freebsd_sysctl(char *ctlname);
@@ -129,6 +289,8 @@ long long longlong_freebsd_sysctl(const char *ctlname);
 
 // shell detection
 #ifdef __linux__
+int is_known_shell(const char *name);
+pid_t proc_stat_parent(pid_t pid, char *name, size_t size);
 char *get_parent_shell(void);
 #endif
 #ifdef __FreeBSD__
@@ -150,16 +312,343 @@ void format_uptime(long int uptime);
 char *get_gpu_name(void);
 #endif
 #endif
+// distro, CPU and memory queries
+int os_release_field(const char *buf, const char *key, char *out,
+                     size_t size);
+int os_release_name(const char *buf, char *out, size_t size);
+int cpuinfo_parse(const char *buf, char *model, size_t size);
+char *get_distro_name(void);
+char *get_distro_version(void);
+char *get_cpu_model(void);
+int get_ram_stats(long long *total, long long *avail);
+void distro_string(char *out, size_t size, const char *name,
+                   const char *version);
+
+// CPU utilization
+struct cpu_stat { // one column per counter, one slot per CPU
+  int ncpu;
+  int cap;
+  int *id;
+  unsigned long long *user; // user + nice
+  unsigned long long *system; // system + irq + softirq
+  unsigned long long *idle;
+  unsigned long long *iowait;
+  unsigned long long *steal;
+};
+struct cpu_usage {
+  double total_pct;
+  double steal_pct;
+  int busiest_cpu;
+  double busiest_pct;
+};
+int cpu_stat_alloc(struct cpu_stat *st, int cap);
+void cpu_stat_free(struct cpu_stat *st);
+int cpu_stat_read(int fd, char *buf, size_t size, struct cpu_stat *st);
+unsigned long long cpu_delta(unsigned long long a, unsigned long long b);
+void cpu_usage_delta(const struct cpu_stat *a, const struct cpu_stat *b,
+                     float *busy_pct, struct cpu_usage *usage);
+int get_cpu_usage(int interval_ms, struct cpu_usage *usage);
+
+// NUMA topology
+int compare_int(const void *a, const void *b);
+int numa_node_meminfo(int nodefd, int node, unsigned long long *total,
+                      unsigned long long *free_kb);
+
+// CPU topology and caches
+int topology_group(int cpufd, int cpu, const char *file, const char *fallback,
+                   unsigned long long *seen);
+void print_cache_size(const char *size);
+void topology_line(int cpufd);
+
+// ISA extensions
+#if defined(__x86_64__) || defined(__i386__)
+unsigned long long read_xcr0(void);
+#endif
+
+// hugepages
+int thp_mode(const char *path, char *mode, size_t size);
+void print_size_kb(long long kb);
+
+// pressure stall information
+int psi_parse(char *buf, int *some, int *full);
+
+// cgroup v2 limits
+struct tinycgroup {
+  long long mem_max; // bytes, -1 when unlimited or unknown
+  long long mem_current;
+  long long cpu_quota; // microseconds per cpu_period, -1 when unlimited
+  long long cpu_period;
+  int cpus; // cpuset.cpus.effective
+};
+long long cgroup_value(char **p);
+int cgroup_open(const char *self, const char *root);
+int cgroup_read(const char *self, const char *root, struct tinycgroup *cg);
+void cgroup_print_size(long long bytes);
+void cgroup_line(int only_limited);
+
+// largest processes
+struct top_entry {
+  int pid;
+  unsigned long long rss; // KiB
+};
+struct top_heap {
+  struct top_entry *entries;
+  int len;
+  int cap;
+};
+struct top_scan {
+  int procfd;
+  const int *pids;
+  int first;
+  int last;
+  int started;
+  struct top_heap heap;
+};
+void top_heap_push(struct top_heap *h, int pid, unsigned long long rss);
+int *top_list_pids(int procfd, int *count);
+void *top_scan(void *data);
+int compare_top_entry(const void *a, const void *b);
+void top_line(int procfd, int count);
+
+// interrupt affinity
+struct irq_source {
+  char name[32];
+  unsigned long long total;
+  unsigned long long max; // on the single busiest CPU
+  int max_cpu;
+};
+struct irq_summary {
+  int ncpu; // columns in the header
+  int cap;
+  int *cpu_id; // column -> CPU number, offline CPUs have no column
+  unsigned long long *cpu_total;
+  unsigned long long device_total;
+  int nsources;
+  struct irq_source top[IRQ_TOP];
+};
+int irq_header(char *line, struct irq_summary *sum);
+void irq_row(char *line, struct irq_summary *sum);
+int irq_summarize(const char *path, struct irq_summary *sum);
+void irq_print_count(unsigned long long count);
+
+// block devices
+struct storage_dev {
+  char name[32];
+  char model[48];
+  char sched[24];
+  unsigned long long bytes;
+  int rotational; // -1 when unknown
+  int nr_requests;
+};
+int natural_compare(const char *a, const char *b);
+void storage_attr(int devfd, const char *path, char *out, size_t size);
+int storage_read(int blockfd, const char *name, struct storage_dev *dev);
+void storage_print_size(unsigned long long bytes);
+
+// network interfaces
+#if ENABLE_NET && defined(__linux__)
+struct net_iface {
+  int index;
+  char name[IF_NAMESIZE];
+  int carrier;
+  int mtu;
+  int rx_queues;
+  int tx_queues;
+  int addr_family; // 0 until an address is found
+  int prefix;
+  char addr[INET6_ADDRSTRLEN];
+};
+struct net_summary {
+  struct net_iface shown[NET_SHOWN]; // the first interfaces that are up
+  int num_shown;
+  int num_more; // up, but past NET_SHOWN
+  int num_down;
+};
+struct net_iface *net_find(struct net_summary *sum, int index);
+void net_link(struct nlmsghdr *nh, struct net_summary *sum);
+void net_addr(struct nlmsghdr *nh, struct net_summary *sum);
+int net_dump(int fd, int type, unsigned int seq,
+             void (*fn)(struct nlmsghdr *, struct net_summary *),
+             struct net_summary *sum);
+#endif
+
+// thermal status
+struct thermal_sensor {
+  char path[40]; // hwmonN/tempM_input
+  int package;
+};
+struct thermal_cache {
+  int discovered;
+  int num_sensors;
+  int num_throttle_cpus;
+  unsigned long long throttle_cpus[CPUSET_WORDS];
+  struct thermal_sensor sensors[THERMAL_MAX_SENSORS];
+};
+void thermal_discover(struct thermal_cache *cache);
+
+// CPU vulnerabilities
+enum {
+  VULN_NOT_AFFECTED,
+  VULN_MITIGATED,
+  VULN_COSTLY,
+  VULN_PARTIAL, // mitigated, but part of it still reported vulnerable
+  VULN_VULNERABLE,
+  VULN_UNKNOWN,
+  VULN_KINDS
+};
+struct vuln {
+  char name[40];
+  char text[256];
+  int kind;
+};
+int mitigation_costly(const char *text);
+int mitigation_classify(const char *text);
+int compare_vuln(const void *a, const void *b);
+void mitigations(int verbose);
+
+// kernel tuning
+void tuning_normalize(char *value);
+int tuning_load_baseline(const char *path);
+
+// latency tuning
+int cmdline_cpulist(const char *cmdline, const char *param, char *out,
+                    size_t size, char *flags, size_t flags_size);
+void sysfs_cpulist(const char *path, char *out, size_t size);
+int cpulist_equal(const char *a, const char *b);
+void latency_set(const char *name, const char *effective,
+                 const char *requested);
+
+// hardware probe
+struct hwprobe {
+  int done;
+  int nthreads;
+  size_t array_bytes; // per array, per worker
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  int arrived;
+  int generation;
+  int stop; // the STREAM budget is spent
+  double copy_time; // best pass, seconds
+  double triad_time;
+  double copy_gbs;
+  double triad_gbs;
+  double core_avg; // Mops/s
+  double core_min;
+};
+struct hwprobe_worker {
+  pthread_t thread;
+  int id;
+  int cpu;
+  struct hwprobe *hp;
+  int pinned; // sched_setaffinity succeeded
+  size_t n;   // doubles per array, 0 if allocation failed
+  double core_mops;
+};
+void hwprobe_sync(struct hwprobe *hp);
+double hwprobe_now(void);
+double hwprobe_core(void);
+void *hwprobe_worker(void *data);
+size_t hwprobe_llc_bytes(const int *cores, int num_cores);
+struct hwprobe *hwprobe_run(void);
+
+// batch rendering
+#if ENABLE_BATCH && defined(__linux__)
+struct batch_buf {
+  char *data;
+  size_t cap;
+};
+struct batch_json {
+  char *out; // grows with the record
+  size_t len;
+  size_t cap;
+  int failed; // out of memory, the record is dropped
+};
+struct batch_worker {
+  pthread_t thread;
+  int id;
+  _Atomic unsigned long long range; // tail << 32 | head
+  struct batch *batch;
+};
+struct batch {
+  int dirfd;
+  char **hosts; // sorted, the output order
+  int num_hosts;
+  char **lines; // rendered, waiting to be printed in order
+  char *failed;
+  int next; // the next line to print
+  pthread_mutex_t lock;
+  pthread_cond_t ready;
+  struct batch_worker *workers;
+  int num_workers;
+};
+char *batch_read(int hostfd, const char *name, struct batch_buf *b);
+int json_reserve(struct batch_json *j, size_t n);
+void json_string(struct batch_json *j, const char *key, const char *value);
+void json_number(struct batch_json *j, const char *key, long long value);
+char *batch_render(int dirfd, const char *host, struct batch_buf *b);
+int batch_pop(struct batch_worker *w);
+int batch_steal(struct batch *batch, struct batch_worker *self);
+void *batch_worker(void *data);
+int compare_string(const void *a, const void *b);
+int tinybatch(const char *dir);
+#endif
+
+// probes
+enum { PROBE_USER, PROBE_DISTRO, PROBE_SHELL, PROBE_CPU, PROBE_GPU, PROBE_COUNT };
+struct tinyprobe {
+  const char *name;
+  char *(*fn)(void *arg);
+  int deadline_ms; // -1 uses probe_default_deadline
+  char *result;
+  int running;
+  int done;
+  int abandoned;
+  struct timespec deadline;
+  void *arg;
+#if ENABLE_PERF_STAT && defined(__linux__)
+  unsigned long long perf_counts[PERF_COUNTERS]; // of the last finished run
+  double perf_ms;
+  int perf_measured;
+#endif
+};
+void probe_init(void);
+void *probe_thread(void *data);
+void probe_start(struct tinyprobe *p);
+void probe_start_all(void);
+int probe_wait(struct tinyprobe *p, char **result);
+int probe_set_deadline(const char *spec);
+char *probe_user(void *arg);
+char *probe_distro(void *arg);
+char *probe_shell(void *arg);
+char *probe_cpu(void *arg);
+char *probe_gpu(void *arg);
+
+// filesystem usage
+struct disk_mount {
+  struct disk_mount *next; // every mount ever seen
+  struct disk_mount *pass_next; // mounts of the current pass, in order
+  char *path;
+  char dev[24]; // major:minor
+  int pass; // the last pass listing this mountpoint
+  struct tinyprobe probe;
+};
+char *probe_disk(void *arg);
+int disk_pseudo_fs(const char *fstype);
+void disk_unescape(char *s);
+struct disk_mount *disk_node(const char *path);
+void disk_line(const char *mountinfo);
+
 // main printing functions
 void pretext(const char *string);
 void fetchinfo(char *structname);
 void tinyinit(void);
 void rand_string(void);
+void tinygenie(void);
 void trim_spaces(char *str);
 void message(char *message);
 int get_swap_status(void);
 int get_cpu_count(void);
-#if defined(__FreeBSD__) || defined(__NetBSD__)
+#if defined(__linux__) || defined(__FreeBSD__) || defined(__NetBSD__)
 int get_swap_stats(long long *total, long long *used, long long *free);
 #endif
 
@@ -173,3 +662,61 @@ void tinyshell(void);
 void tinyuptime(void);
 void tinywm(void);
 void tinyram(void);
+void tinycpu(void);
+void tinygpu(void);
+void tinycpuusage(void);
+void tinynuma(void);
+void tinytopology(void);
+void tinyisa(void);
+void tinyhugepages(void);
+void tinypressure(void);
+void tinycgroup(void);
+void tinycgroup_limited(void);
+void tinytop(void);
+void tinyirq(void);
+void tinystorage(void);
+void tinydisk(void);
+void tinynet(void);
+void tinythermal(void);
+void tinymitigations(void);
+void tinymitigations_verbose(void);
+void tinytuning(void);
+void tinylatency(void);
+void tinyswap(void);
+void tinyfetch(char *msg);
+
+// prometheus textfile output
+void prom_label(FILE *out, const char *name, const char *value, int first);
+void prom_gauge(FILE *out, const char *name, const char *help,
+                long long value);
+int tinyprom(const char *path);
+
+// self profiling
+#if ENABLE_PERF_STAT && defined(__linux__)
+struct perf_section {
+  const char *name;
+  unsigned long long counts[PERF_COUNTERS];
+  double ms;
+};
+int perf_fds[PERF_COUNTERS];
+int perf_errno; // why the first counter that failed did
+long long perf_startup_faults;
+long long perf_startup_switches;
+struct perf_section perf_sections[PERF_MAX_SECTIONS];
+int perf_num_sections;
+int perf_open_counters(int *fds);
+void perf_open(void);
+void perf_read(const int *fds, unsigned long long *values);
+void perf_print_count(int counter, unsigned long long value);
+void perf_report(void);
+#endif
+void tinyrun(const char *name, void (*fn)(void));
+
+// command line handling
+struct tinycmd {
+  const char *flag;
+  void (*fn)(void);
+};
+const struct tinycmd *find_command(const char *arg);
+int parse_global_options(int argc, char *argv[]);
+int tinymain(int argc, char *argv[]);
@@ -0,0 +1,84 @@
+// tinyfetch Copyright (C) 2024 kernaltrap8
+// This program comes with ABSOLUTELY NO WARRANTY
+// This is free software, and you are welcome to redistribute it
+// under certain conditions
+
+/*
+    bench_batch.c: --batch throughput over 1k and 10k synthetic snapshots
+*/
+
+#include "fixture.h"
+
+#define BENCH_CPUS 16 // per snapshot, about 16 KiB of cpuinfo
+
+// the big files are hard links to one copy, so 10k hosts cost 10k inodes
+// rather than 160 MiB; uname differs per host
+void write_snapshots(int hosts) {
+  FILE *file = fopen("cpuinfo", "w");
+  if (file == NULL) {
+    perror("cpuinfo");
+    exit(1);
+  }
+  for (int cpu = 0; cpu < BENCH_CPUS; cpu++) {
+    fprintf(file,
+            "processor\t: %d\nvendor_id\t: GenuineIntel\ncpu family\t: 6\n"
+            "model\t\t: 106\nmodel name\t: Intel(R) Xeon(R) Gold 6338 CPU @ "
+            "2.00GHz\ncpu MHz\t\t: 2000.000\ncache size\t: 49152 KB\n"
+            "flags\t\t:",
+            cpu);
+    for (int flag = 0; flag < 120; flag++) {
+      fprintf(file, " flag%d", flag);
+    }
+    fprintf(file, "\nbogomips\t: 4000.00\n\n");
+  }
+  fclose(file);
+  fixture_write("os-release", "PRETTY_NAME=\"Ubuntu 22.04.4 LTS\"\n"
+                              "NAME=\"Ubuntu\"\nVERSION_ID=\"22.04\"\n"
+                              "ID=ubuntu\nID_LIKE=debian\n");
+  fixture_write("meminfo", "MemTotal:       263921344 kB\n"
+                           "MemFree:         1204312 kB\n"
+                           "MemAvailable:   201933120 kB\n"
+                           "Buffers:          501234 kB\n"
+                           "Cached:         190123456 kB\n"
+                           "SwapTotal:       8388604 kB\n"
+                           "SwapFree:        8388604 kB\n");
+  char path[64], target[64];
+  for (int host = 0; host < hosts; host++) {
+    snprintf(path, sizeof(path), "snap%d/host%05d/uname", hosts, host);
+    fixture_write(path, "Linux host%05d 6.5.0-%d-generic x86_64\n", host,
+                  host % 40);
+    const char *files[] = {"cpuinfo", "os-release", "meminfo"};
+    for (int i = 0; i < 3; i++) {
+      snprintf(target, sizeof(target), "snap%d/host%05d/%s", hosts, host,
+               files[i]);
+      if (link(files[i], target) != 0) {
+        perror(target);
+        exit(1);
+      }
+    }
+  }
+}
+
+int main(void) {
+  fixture_init();
+  for (int hosts = 1000; hosts <= 10000; hosts *= 10) {
+    write_snapshots(hosts);
+    char dir[32];
+    snprintf(dir, sizeof(dir), "snap%d", hosts);
+
+    capture_start();
+    double start = fixture_now();
+    int ret = tinybatch(dir);
+    double elapsed = fixture_now() - start;
+    const char *out = capture_end();
+    CHECK(ret == 0);
+    CHECK(strstr(out, "\"distro\":\"Ubuntu 22.04\",\"cpu\":\"Intel(R) "
+                      "Xeon(R) Gold 6338 CPU @ 2.00GHz (16)\"") != NULL);
+
+    struct stat st;
+    CHECK(stat("stdout", &st) == 0);
+    printf("%5d hosts: %7.1f ms, %8.0f hosts/s, %5.1f MiB of JSON\n", hosts,
+           elapsed * 1e3, hosts / elapsed, st.st_size / 1048576.0);
+  }
+  return fixture_result();
+}
@@ -0,0 +1,76 @@
+// tinyfetch Copyright (C) 2024 kernaltrap8
+// This program comes with ABSOLUTELY NO WARRANTY
+// This is free software, and you are welcome to redistribute it
+// under certain conditions
+
+/*
+    bench_cpu_usage.c: /proc/stat parse plus delta on 1024 CPUs
+*/
+
+#include "fixture.h"
+
+#define BENCH_CPUS 1024
+#define BENCH_ROUNDS 2000
+
+// a /proc/stat with BENCH_CPUS cpuN lines, every counter advanced by tick
+void write_stat(const char *path, unsigned long long tick) {
+  FILE *file = fopen(path, "w");
+  if (file == NULL) {
+    perror(path);
+    exit(1);
+  }
+  fprintf(file, "cpu  %llu 0 %llu %llu %llu 0 0 0 0 0\n", tick * 1024,
+          tick * 512, tick * 4096, tick * 128);
+  for (int cpu = 0; cpu < BENCH_CPUS; cpu++) {
+    unsigned long long base = 1000000ULL * (cpu + 1);
+    // cpu1's iowait goes backwards, which the kernel allows
+    unsigned long long iowait = (cpu == 1) ? base - tick * 50 : base + tick;
+    fprintf(file, "cpu%d %llu 7 %llu %llu %llu 3 5 %llu 0 0\n", cpu,
+            base + tick * (cpu % 64), base + tick, base + tick * 20, iowait,
+            base + tick / 2);
+  }
+  fprintf(file, "intr 123456789 0 1 2 3\nctxt 987654321\n");
+  fclose(file);
+}
+
+int main(void) {
+  fixture_init();
+  write_stat("stat.a", 0);
+  write_stat("stat.b", 100);
+  int fd_a = open("stat.a", O_RDONLY | O_CLOEXEC);
+  int fd_b = open("stat.b", O_RDONLY | O_CLOEXEC);
+  size_t size = (size_t)(BENCH_CPUS + 2) * 256;
+  char *buf = malloc(size);
+  float *busy_pct = calloc(BENCH_CPUS, sizeof(*busy_pct));
+  struct cpu_stat a, b;
+  struct cpu_usage usage;
+  if (fd_a < 0 || fd_b < 0 || buf == NULL || busy_pct == NULL ||
+      cpu_stat_alloc(&a, BENCH_CPUS) != 0 ||
+      cpu_stat_alloc(&b, BENCH_CPUS) != 0) {
+    return 1;
+  }
+
+  double parse = 0, delta = 0;
+  for (int round = 0; round < BENCH_ROUNDS; round++) {
+    double start = fixture_now();
+    cpu_stat_read(fd_a, buf, size, &a);
+    cpu_stat_read(fd_b, buf, size, &b);
+    double mid = fixture_now();
+    cpu_usage_delta(&a, &b, busy_pct, &usage);
+    parse += mid - start;
+    delta += fixture_now() - mid;
+  }
+  printf("%d CPUs: %.1f us per sample parsed, %.2f us per delta\n",
+         BENCH_CPUS, parse / BENCH_ROUNDS / 2 * 1e6,
+         delta / BENCH_ROUNDS * 1e6);
+
+  CHECK(a.ncpu == BENCH_CPUS && b.ncpu == BENCH_CPUS);
+  CHECK(usage.total_pct >= 0.0 && usage.total_pct <= 100.0);
+  CHECK(usage.busiest_pct >= 0.0 && usage.busiest_pct <= 100.0);
+  CHECK(usage.busiest_cpu == 63); // the most user time, cpu1 notwithstanding
+  cpu_stat_free(&a);
+  cpu_stat_free(&b);
+  free(busy_pct);
+  free(buf);
+  return fixture_result();
+}
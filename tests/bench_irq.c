@@ -0,0 +1,68 @@
+// tinyfetch Copyright (C) 2024 kernaltrap8
+// This program comes with ABSOLUTELY NO WARRANTY
+// This is free software, and you are welcome to redistribute it
+// under certain conditions
+
+/*
+    bench_irq.c: /proc/interrupts summary on 512 CPUs, 128 to 2048 rows
+*/
+
+#include "fixture.h"
+
+#define BENCH_CPUS 512
+#define BENCH_ROUNDS 20
+
+// every device row lands mostly on one CPU; row r's total grows with r
+long write_interrupts(const char *path, int rows) {
+  FILE *file = fopen(path, "w");
+  if (file == NULL) {
+    perror(path);
+    exit(1);
+  }
+  fprintf(file, "      ");
+  for (int cpu = 0; cpu < BENCH_CPUS; cpu++) {
+    fprintf(file, "      CPU%-4d", cpu);
+  }
+  fprintf(file, "\n");
+  for (int row = 0; row < rows; row++) {
+    fprintf(file, "%4d: ", row + 24);
+    for (int cpu = 0; cpu < BENCH_CPUS; cpu++) {
+      fprintf(file, " %10d", (cpu == row % BENCH_CPUS) ? 1000000 + row : 3);
+    }
+    fprintf(file, "  IR-PCI-MSIX-0000:3b:00.0 %d-edge mlx5_comp%d@pci\n",
+            row, row);
+  }
+  fprintf(file, "NMI: ");
+  for (int cpu = 0; cpu < BENCH_CPUS; cpu++) {
+    fprintf(file, " %10d", 7);
+  }
+  fprintf(file, "   Non-maskable interrupts\nERR:          0\n");
+  long size = ftell(file);
+  fclose(file);
+  return size;
+}
+
+int main(void) {
+  fixture_init();
+  static struct irq_summary sum;
+  for (int rows = 128; rows <= 2048; rows *= 4) {
+    long size = write_interrupts("interrupts", rows);
+    double best = 1e9;
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+      double start = fixture_now();
+      CHECK(irq_summarize("interrupts", &sum) == 0);
+      double elapsed = fixture_now() - start;
+      best = (elapsed < best) ? elapsed : best;
+    }
+    printf("%4d rows, %5.1f MiB: %7.2f ms, %6.0f MiB/s\n", rows,
+           size / 1048576.0, best * 1e3, size / 1048576.0 / best);
+
+    char name[32];
+    snprintf(name, sizeof(name), "mlx5_comp%d@pci", rows - 1);
+    CHECK(sum.ncpu == BENCH_CPUS);
+    CHECK(sum.nsources == IRQ_TOP);
+    CHECK(!strcmp(sum.top[0].name, name));
+    CHECK(sum.top[0].max_cpu == (rows - 1) % BENCH_CPUS);
+  }
+  return fixture_result();
+}
@@ -0,0 +1,61 @@
+// tinyfetch Copyright (C) 2024 kernaltrap8
+// This program comes with ABSOLUTELY NO WARRANTY
+// This is free software, and you are welcome to redistribute it
+// under certain conditions
+
+/*
+    bench_shell.c: get_parent_shell() under deep process trees
+*/
+
+#include "fixture.h"
+#include <sys/prctl.h>
+
+#define BENCH_LOOKUPS 20000
+
+// forks a chain of depth processes: a "bash" at the top, wrappers in between
+// and the benchmark at the bottom. every link exits with the leaf's status.
+int bench_depth(int depth) {
+  pid_t child = fork();
+  if (child != 0) {
+    int status = 1;
+    waitpid(child, &status, 0);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+  }
+  prctl(PR_SET_NAME, "bash");
+  for (int level = 1; level < depth; level++) {
+    if ((child = fork()) != 0) {
+      int status = 1;
+      waitpid(child, &status, 0);
+      _exit(WIFEXITED(status) ? WEXITSTATUS(status) : 1);
+    }
+    prctl(PR_SET_NAME, (level % 2) ? "sudo" : "tmux: server");
+  }
+  if (fork() != 0) {
+    int status = 1;
+    wait(&status);
+    _exit(WIFEXITED(status) ? WEXITSTATUS(status) : 1);
+  }
+
+  char *shell = get_parent_shell();
+  int found = shell != NULL && !strcmp(shell, "bash");
+  free(shell);
+  double start = fixture_now();
+  for (int i = 0; i < BENCH_LOOKUPS; i++) {
+    free(get_parent_shell());
+  }
+  double elapsed = fixture_now() - start;
+  printf("depth %2d: %7.2f us per lookup, %6.2f us per level%s\n", depth,
+         elapsed / BENCH_LOOKUPS * 1e6, elapsed / BENCH_LOOKUPS / depth * 1e6,
+         found ? "" : " (shell not found)");
+  fflush(stdout);
+  _exit(found ? 0 : 1);
+}
+
+int main(void) {
+  int depths[] = {1, 2, 4, 8, SHELL_SEARCH_DEPTH};
+  int failed = 0;
+  for (size_t i = 0; i < sizeof(depths) / sizeof(depths[0]); i++) {
+    failed |= bench_depth(depths[i]);
+  }
+  return failed;
+}
@@ -0,0 +1,67 @@
+// tinyfetch Copyright (C) 2024 kernaltrap8
+// This program comes with ABSOLUTELY NO WARRANTY
+// This is free software, and you are welcome to redistribute it
+// under certain conditions
+
+/*
+    bench_top.c: --top over synthetic /proc trees of 1k to 100k processes
+*/
+
+#include "fixture.h"
+
+#define BENCH_TOP 10
+
+// <pid>/statm for pids first..last-1, pid 1000 + i has i pages. there is no
+// comm, so the names print as "?"
+void add_processes(int procfd, int first, int last) {
+  for (int pid = first; pid < last; pid++) {
+    char name[32], buf[64];
+    snprintf(name, sizeof(name), "%d", pid);
+    if (mkdirat(procfd, name, 0755) != 0) {
+      perror(name);
+      exit(1);
+    }
+    int dirfd = openat(procfd, name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    int fd = openat(dirfd, "statm", O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+    int len = snprintf(buf, sizeof(buf), "%d %d 100 10 0 50 0\n",
+                       2 * (pid - 1000), pid - 1000);
+    if (fd < 0 || write(fd, buf, len) != len) {
+      exit(1);
+    }
+    close(fd);
+    close(dirfd);
+  }
+}
+
+int main(void) {
+  fixture_init();
+  mkdir("proc", 0755);
+  int procfd = open("proc", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  int sizes[] = {1000, 10000, 100000};
+  int have = 0;
+  for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    add_processes(procfd, 1000 + have, 1000 + sizes[i]);
+    have = sizes[i];
+
+    double best = 1e9;
+    for (int run = 0; run < 3; run++) {
+      capture_start();
+      double start = fixture_now();
+      top_line(procfd, BENCH_TOP);
+      double elapsed = fixture_now() - start;
+      capture_end();
+      best = (elapsed < best) ? elapsed : best;
+    }
+    printf("%6d processes: %8.2f ms, %5.2f us per process\n", have,
+           best * 1e3, best / have * 1e6);
+
+    // the largest is the last pid, with have - 1 pages
+    char largest[64];
+    snprintf(largest, sizeof(largest), "Top RSS:    ? (%d)", 999 + have);
+    CHECK(strstr(fixture_out, largest) != NULL);
+  }
+  printf("%d scan threads\n",
+         get_cpu_count() < TOP_MAX_THREADS ? get_cpu_count() : TOP_MAX_THREADS);
+  close(procfd);
+  return fixture_result();
+}
@@ -0,0 +1,127 @@
+// tinyfetch Copyright (C) 2024 kernaltrap8
+// This program comes with ABSOLUTELY NO WARRANTY
+// This is free software, and you are welcome to redistribute it
+// under certain conditions
+
+/*
+    fixture.h
+*/
+
+// every test is one program built around tinyfetch.c itself, so it calls the
+// collectors directly instead of scraping the binary's output
+#define main tinyfetch_main
+#include "../src/tinyfetch.c"
+#undef main
+
+#include <stdarg.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#define FIXTURE_SKIP 77 // meson's exit code for a skipped test
+
+int fixture_failures;
+char fixture_root[PATH_MAX];
+char fixture_out[65536];
+int fixture_saved_stdout = -1;
+
+#define CHECK(cond)                                                            \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__,        \
+              #cond);                                                          \
+      fixture_failures++;                                                      \
+    }                                                                          \
+  } while (0)
+
+void fixture_remove(int dirfd, const char *name) {
+  int fd = openat(dirfd, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+  if (fd < 0) {
+    unlinkat(dirfd, name, 0);
+    return;
+  }
+  DIR *dir = fdopendir(fd);
+  struct dirent *entry;
+  while (dir != NULL && (entry = readdir(dir)) != NULL) {
+    if (strcmp(entry->d_name, ".") && strcmp(entry->d_name, "..")) {
+      fixture_remove(fd, entry->d_name);
+    }
+  }
+  if (dir != NULL) {
+    closedir(dir);
+  }
+  unlinkat(dirfd, name, AT_REMOVEDIR);
+}
+
+void fixture_cleanup(void) {
+  if (fixture_root[0] != '\0') {
+    fixture_remove(AT_FDCWD, fixture_root);
+  }
+}
+
+// a fresh directory under $TMPDIR, made the working directory so fixture
+// paths are relative, and removed again at exit
+void fixture_init(void) {
+  const char *tmp = getenv("TMPDIR");
+  snprintf(fixture_root, sizeof(fixture_root), "%s/tinyfetch-test-XXXXXX",
+           (tmp != NULL && tmp[0] != '\0') ? tmp : "/tmp");
+  if (mkdtemp(fixture_root) == NULL || chdir(fixture_root) != 0) {
+    perror("tinyfetch: fixture directory");
+    exit(1);
+  }
+  atexit(fixture_cleanup);
+}
+
+// writes a fixture file, creating its parent directories
+void fixture_write(const char *path, const char *fmt, ...) {
+  char dir[PATH_MAX];
+  snprintf(dir, sizeof(dir), "%s", path);
+  for (char *slash = strchr(dir + 1, '/'); slash != NULL;
+       slash = strchr(slash + 1, '/')) {
+    *slash = '\0';
+    mkdir(dir, 0755);
+    *slash = '/';
+  }
+  FILE *file = fopen(path, "w");
+  if (file == NULL) {
+    perror(path);
+    exit(1);
+  }
+  va_list args;
+  va_start(args, fmt);
+  vfprintf(file, fmt, args);
+  va_end(args);
+  fclose(file);
+}
+
+double fixture_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// stdout goes to a file between these two, for collectors that print
+void capture_start(void) {
+  fflush(stdout);
+  fixture_saved_stdout = dup(STDOUT_FILENO);
+  int fd = open("stdout", O_RDWR | O_CREAT | O_TRUNC, 0644);
+  dup2(fd, STDOUT_FILENO);
+  close(fd);
+}
+
+const char *capture_end(void) {
+  fflush(stdout);
+  dup2(fixture_saved_stdout, STDOUT_FILENO);
+  close(fixture_saved_stdout);
+  ssize_t n = file_read_at(AT_FDCWD, "stdout", fixture_out,
+                           sizeof(fixture_out));
+  fixture_out[n > 0 ? n : 0] = '\0';
+  return fixture_out;
+}
+
+int fixture_result(void) {
+  if (fixture_failures > 0) {
+    fprintf(stderr, "%d check(s) failed\n", fixture_failures);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,117 @@
+// tinyfetch Copyright (C) 2024 kernaltrap8
+// This program comes with ABSOLUTELY NO WARRANTY
+// This is free software, and you are welcome to redistribute it
+// under certain conditions
+
+/*
+    test_batch.c: --batch on ordinary, empty and hostile snapshots
+*/
+
+#include "fixture.h"
+
+#define HOSTILE_LEN 200
+
+// one JSON object per line, strings closed, no raw control characters
+int json_line_valid(const char *line, size_t len) {
+  if (len < 3 || line[0] != '{' || line[len - 2] != '}' ||
+      line[len - 1] != '\n') {
+    return 0;
+  }
+  int in_string = 0;
+  for (size_t i = 1; i < len - 2; i++) {
+    unsigned char c = line[i];
+    if (c < 0x20) {
+      return 0;
+    } else if (in_string && c == '\\') {
+      if (line[i + 1] == 'u') {
+        for (int k = 2; k < 6; k++) {
+          if (!isxdigit((unsigned char)line[i + k])) {
+            return 0;
+          }
+        }
+        i += 5;
+      } else if (line[i + 1] == '"' || line[i + 1] == '\\') {
+        i++;
+      } else {
+        return 0;
+      }
+    } else if (c == '"') {
+      in_string = !in_string;
+    } else if (!in_string && (c == '{' || c == '}')) {
+      return 0;
+    }
+  }
+  return !in_string;
+}
+
+int main(void) {
+  fixture_init();
+  fixture_write("snap/a-plain/uname", "Linux web1 6.1.0-18-amd64 x86_64\n");
+  fixture_write("snap/a-plain/os-release",
+                "PRETTY_NAME=\"Debian GNU/Linux 12 (bookworm)\"\n"
+                "NAME=\"Debian GNU/Linux\"\nVERSION_ID=\"12\"\n");
+  fixture_write("snap/a-plain/cpuinfo",
+                "processor\t: 0\nmodel name\t: Intel(R) Xeon(R) Gold 6338\n\n"
+                "processor\t: 1\nmodel name\t: Intel(R) Xeon(R) Gold 6338\n\n");
+  fixture_write("snap/a-plain/meminfo",
+                "MemTotal:       16384000 kB\nMemFree:         1000000 kB\n"
+                "MemAvailable:    8192000 kB\nSwapTotal:             0 kB\n"
+                "SwapFree:              0 kB\n");
+  mkdir("snap/b-empty", 0755);
+  fixture_write("snap/c-not-a-directory", "");
+
+  // every field at its size limit, all of it escaped six-fold
+  char hostile[HOSTILE_LEN + 1];
+  memset(hostile, '\x01', HOSTILE_LEN);
+  hostile[HOSTILE_LEN] = '\0';
+  fixture_write("snap/d-hostile/uname", "%s %s %s %s\n", hostile, hostile,
+                hostile, hostile);
+  fixture_write("snap/d-hostile/os-release", "NAME=%s\nVERSION_ID=%s\n",
+                hostile, hostile);
+  fixture_write("snap/d-hostile/cpuinfo", "processor\t: 0\nmodel name\t: %s\n",
+                hostile);
+  fixture_write("snap/e-quotes/os-release",
+                "NAME=\"a\\b\"\nVERSION_ID=3.19.1\n");
+
+  capture_start();
+  CHECK(tinybatch("snap") == 0);
+  const char *out = capture_end();
+
+  const char *hosts[] = {"a-plain", "b-empty", "c-not-a-directory",
+                         "d-hostile", "e-quotes"};
+  const char *line = out;
+  for (size_t i = 0; i < sizeof(hosts) / sizeof(hosts[0]); i++) {
+    const char *end = strchr(line, '\n');
+    CHECK(end != NULL);
+    if (end == NULL) {
+      break;
+    }
+    size_t len = end + 1 - line;
+    char want[64];
+    snprintf(want, sizeof(want), "{\"host\":\"%s\"", hosts[i]);
+    if (strncmp(line, want, strlen(want)) || !json_line_valid(line, len)) {
+      printf("bad line for %s: %.*s", hosts[i], (int)len, line);
+      fixture_failures++;
+    }
+    line = end + 1;
+  }
+  CHECK(*line == '\0');
+
+  CHECK(strstr(out, "\"hostname\":\"web1\",\"os\":\"GNU/Linux\","
+                    "\"kernel\":\"6.1.0-18-amd64\",\"arch\":\"x86_64\","
+                    "\"distro\":\"Debian 12\","
+                    "\"cpu\":\"Intel(R) Xeon(R) Gold 6338 (2)\",\"cpus\":2,"
+                    "\"mem_total\":16777216000,"
+                    "\"mem_available\":8388608000") != NULL);
+  CHECK(strstr(out, "{\"host\":\"b-empty\",\"hostname\":null,\"os\":null,"
+                    "\"kernel\":null,\"arch\":null,"
+                    "\"distro\":\"Generic Linux\",\"cpu\":null,"
+                    "\"cpus\":null,\"mem_total\":null") != NULL);
+  CHECK(strstr(out, "{\"host\":\"c-not-a-directory\",\"error\":") != NULL);
+  CHECK(strstr(out, "\"distro\":\"a\\\\b 3.19.1\"") != NULL);
+
+  // the hostile record is whole, well past the old 4 KiB line
+  const char *d = strstr(out, "{\"host\":\"d-hostile\"");
+  CHECK(d != NULL && strchr(d, '\n') - d > 4096);
+  return fixture_result();
+}
@@ -0,0 +1,60 @@
+// tinyfetch Copyright (C) 2024 kernaltrap8
+// This program comes with ABSOLUTELY NO WARRANTY
+// This is free software, and you are welcome to redistribute it
+// under certain conditions
+
+/*
+    test_cgroup.c: cgroup v2 limits from fake /proc/self/cgroup and cgroupfs
+*/
+
+#include "fixture.h"
+
+int main(void) {
+  fixture_init();
+  struct tinycgroup cg;
+
+  // a pod with every limit set, on a pure v2 mount
+  fixture_write("pod/cgroup", "0::/kubepods/pod1/ctr\n");
+  fixture_write("pod/fs/cgroup.controllers", "cpuset cpu io memory pids\n");
+  fixture_write("pod/fs/kubepods/pod1/ctr/memory.max", "536870912\n");
+  fixture_write("pod/fs/kubepods/pod1/ctr/memory.current", "123456789\n");
+  fixture_write("pod/fs/kubepods/pod1/ctr/cpu.max", "150000 100000\n");
+  fixture_write("pod/fs/kubepods/pod1/ctr/cpuset.cpus.effective", "0-3,8\n");
+  CHECK(cgroup_read("pod/cgroup", "pod/fs", &cg) == 0);
+  CHECK(cg.mem_max == 536870912);
+  CHECK(cg.mem_current == 123456789);
+  CHECK(cg.cpu_quota == 150000 && cg.cpu_period == 100000);
+  CHECK(cg.cpus == 5);
+  // the cpuset is counted afresh on every read
+  CHECK(cgroup_read("pod/cgroup", "pod/fs", &cg) == 0 && cg.cpus == 5);
+
+  // "max" is no limit
+  fixture_write("open/cgroup", "0::/user.slice\n");
+  fixture_write("open/fs/cgroup.controllers", "cpu memory\n");
+  fixture_write("open/fs/user.slice/memory.max", "max\n");
+  fixture_write("open/fs/user.slice/cpu.max", "max 100000\n");
+  CHECK(cgroup_read("open/cgroup", "open/fs", &cg) == 0);
+  CHECK(cg.mem_max == -1 && cg.mem_current == -1);
+  CHECK(cg.cpu_quota == -1 && cg.cpu_period == 100000);
+  CHECK(cg.cpus == -1);
+
+  // hybrid: v1 controllers, v2 mounted at <root>/unified
+  fixture_write("hybrid/cgroup", "12:memory:/foo\n1:name=systemd:/foo\n"
+                                 "0::/foo\n");
+  fixture_write("hybrid/fs/unified/cgroup.controllers", "\n");
+  fixture_write("hybrid/fs/unified/foo/memory.max", "1073741824\n");
+  CHECK(cgroup_read("hybrid/cgroup", "hybrid/fs", &cg) == 0);
+  CHECK(cg.mem_max == 1073741824);
+
+  // the root cgroup has none of the files
+  fixture_write("root/cgroup", "0::/\n");
+  fixture_write("root/fs/cgroup.controllers", "cpu memory\n");
+  CHECK(cgroup_read("root/cgroup", "root/fs", &cg) == 0);
+  CHECK(cg.mem_max == -1 && cg.cpu_quota == -1 && cg.cpus == -1);
+
+  // v1 only, and no /proc at all
+  fixture_write("v1/cgroup", "12:memory:/foo\n");
+  CHECK(cgroup_read("v1/cgroup", "v1/fs", &cg) == -1);
+  CHECK(cgroup_read("missing/cgroup", "missing/fs", &cg) == -1);
+  return fixture_result();
+}
@@ -0,0 +1,113 @@
+// tinyfetch Copyright (C) 2024 kernaltrap8
+// This program comes with ABSOLUTELY NO WARRANTY
+// This is free software, and you are welcome to redistribute it
+// under certain conditions
+
+/*
+    test_disk.c: the Disk line with a hung mount, a long mountinfo and an
+    over-mount
+*/
+
+#include "fixture.h"
+
+#define TEST_DEADLINE_MS 100
+#define TEST_SLACK_MS 400
+
+char mountinfo[65536];
+
+// a filesystem of 1 GiB, half used; /mnt/nfs never answers
+int fake_statvfs(const char *path, struct statvfs *st) {
+  if (!strcmp(path, "/mnt/nfs")) {
+    for (;;) {
+      pause();
+    }
+  }
+  memset(st, 0, sizeof(*st));
+  st->f_frsize = 4096;
+  st->f_blocks = 262144;
+  st->f_bfree = st->f_bavail = 131072;
+  return 0;
+}
+
+// hands mountinfo out a page at a time, the way the kernel's seq_file does
+void *feed_pipe(void *data) {
+  int fd = *(int *)data;
+  size_t len = strlen(mountinfo);
+  for (size_t off = 0; off < len; off += 4096) {
+    size_t n = (len - off < 4096) ? len - off : 4096;
+    if (write(fd, mountinfo + off, n) != (ssize_t)n) {
+      break;
+    }
+    usleep(1000);
+  }
+  close(fd);
+  return NULL;
+}
+
+const char *run_pass(void) {
+  int fds[2];
+  pthread_t feeder;
+  char path[64];
+  if (pipe(fds) != 0 ||
+      pthread_create(&feeder, NULL, feed_pipe, &fds[1]) != 0) {
+    exit(1);
+  }
+  snprintf(path, sizeof(path), "/proc/self/fd/%d", fds[0]);
+  capture_start();
+  disk_line(path);
+  const char *out = capture_end();
+  pthread_join(feeder, NULL);
+  close(fds[0]);
+  return out;
+}
+
+int count(const char *haystack, const char *needle) {
+  int n = 0;
+  for (const char *c = strstr(haystack, needle); c != NULL;
+       c = strstr(c + 1, needle)) {
+    n++;
+  }
+  return n;
+}
+
+int main(void) {
+  fixture_init();
+  disk_statvfs = fake_statvfs;
+  disk_deadline = TEST_DEADLINE_MS;
+
+  size_t len = 0;
+#define MOUNT(...)                                                             \
+  len += snprintf(mountinfo + len, sizeof(mountinfo) - len, __VA_ARGS__)
+  MOUNT("22 1 8:1 / / rw,relatime shared:1 - ext4 /dev/sda1 rw\n");
+  MOUNT("23 22 0:60 / /mnt/nfs rw shared:2 - nfs4 srv:/export rw\n");
+  MOUNT("24 22 8:2 / /mnt/over rw shared:3 - ext4 /dev/sda2 rw\n");
+  MOUNT("25 24 8:3 / /mnt/over rw shared:4 - xfs /dev/sda3 rw\n");
+  MOUNT("26 22 8:4 / /mnt/after rw shared:5 - xfs /dev/sda4 rw\n");
+  MOUNT("27 22 8:1 /srv /srv/bind rw shared:1 - ext4 /dev/sda1 rw\n");
+  for (int i = 0; i < 120; i++) { // well past the first page
+    MOUNT("%d 22 0:%d / /run/user/%d rw,nosuid,nodev shared:%d - tmpfs "
+          "tmpfs rw,size=817624k,nr_inodes=204406,mode=700,uid=%d\n",
+          100 + i, 100 + i, 1000 + i, 100 + i, 1000 + i);
+  }
+  MOUNT("300 22 0:200 / /var/lib/docker/overlay2/abc/merged rw shared:300 - "
+        "overlay overlay rw,lowerdir=/l,upperdir=/u,workdir=/w\n");
+#undef MOUNT
+  CHECK(len > 3 * 4096);
+
+  // the full list, passes after the first included (--interval)
+  for (int pass = 0; pass < 3; pass++) {
+    double start = fixture_now();
+    const char *out = run_pass();
+    double elapsed_ms = (fixture_now() - start) * 1e3;
+    printf("%s", out);
+    CHECK(strstr(out, "/mnt/nfs unresponsive") != NULL);
+    CHECK(elapsed_ms < TEST_DEADLINE_MS + TEST_SLACK_MS);
+    CHECK(strstr(out, "/ 0.5/1.0 GiB (50%)") != NULL);
+    CHECK(count(out, "/mnt/over ") == 1);
+    CHECK(strstr(out, "/mnt/after ") != NULL);
+    CHECK(strstr(out, "/var/lib/docker/overlay2/abc/merged ") != NULL);
+    CHECK(strstr(out, "/srv/bind") == NULL);
+    CHECK(strstr(out, "/run/user") == NULL);
+  }
+  return fixture_result();
+}
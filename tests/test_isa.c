@@ -0,0 +1,117 @@
+// tinyfetch Copyright (C) 2024 kernaltrap8
+// This program comes with ABSOLUTELY NO WARRANTY
+// This is free software, and you are welcome to redistribute it
+// under certain conditions
+
+/*
+    test_isa.c: the ISA line against the kernel's /proc/cpuinfo flags
+*/
+
+#include "fixture.h"
+
+char flags[16384];
+
+// the first "flags" (x86) or "Features" (arm64) line, space-delimited
+int read_flags(const char *key) {
+  static char cpuinfo[1 << 20];
+  if (file_read_at(AT_FDCWD, "/proc/cpuinfo", cpuinfo, sizeof(cpuinfo)) <= 0) {
+    return -1;
+  }
+  for (char *line = cpuinfo; line != NULL; line = strchr(line, '\n')) {
+    line += (*line == '\n');
+    if (!strncmp(line, key, strlen(key))) {
+      char *value = strchr(line, ':');
+      if (value == NULL) {
+        return -1;
+      }
+      snprintf(flags, sizeof(flags), " %.*s ",
+               (int)strcspn(value + 1, "\n"), value + 1);
+      return 0;
+    }
+  }
+  return -1;
+}
+
+int has_flag(const char *flag) {
+  char word[64];
+  snprintf(word, sizeof(word), " %s ", flag);
+  return strstr(flags, word) != NULL;
+}
+
+// a whole token of the ISA line, so "SHA" doesn't match "SHA2" or "AES" "VAES"
+int has_token(const char *line, const char *token) {
+  size_t len = strlen(token);
+  for (const char *c = strstr(line, token); c != NULL;
+       c = strstr(c + 1, token)) {
+    int before = (c == line) ? ' ' : c[-1];
+    int after = c[len];
+    if (!isalnum(before) && before != '-' && !isalnum(after) && after != '-') {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// reported iff the kernel reports it too
+void cross_check(const char *line, const char *token, int expected) {
+  if (has_token(line, token) != expected) {
+    fprintf(stderr, "%s: ISA line says %d, cpuinfo flags say %d\n", token,
+            has_token(line, token), expected);
+    fixture_failures++;
+  }
+}
+
+int main(void) {
+  fixture_init();
+  capture_start();
+  tinyisa();
+  const char *line = capture_end();
+  printf("%s", line);
+
+#if defined(__x86_64__) || defined(__i386__)
+  if (read_flags("flags") != 0) {
+    return FIXTURE_SKIP;
+  }
+  int avx512 = has_flag("avx512f") && has_flag("avx512bw") &&
+               has_flag("avx512dq") && has_flag("avx512vl");
+  int avx = has_flag("avx");
+  int avx2 = avx && has_flag("avx2") && has_flag("bmi2") && has_flag("fma");
+  int sse42 = has_flag("sse4_2") && has_flag("popcnt");
+  char level[16];
+  snprintf(level, sizeof(level), "x86-64-v%d",
+           avx512 ? 4 : avx2 ? 3 : sse42 ? 2 : 1);
+  cross_check(line, level, 1);
+  cross_check(line, "AVX-512", avx512);
+  cross_check(line, "AVX2", avx2 && !avx512);
+  cross_check(line, "AVX512-VNNI", avx512 && has_flag("avx512_vnni"));
+  cross_check(line, "AMX", has_flag("amx_tile"));
+  cross_check(line, "SHA", has_flag("sha_ni"));
+  cross_check(line, "AES-NI", has_flag("aes"));
+  cross_check(line, "VAES", avx && has_flag("vaes"));
+  cross_check(line, "GFNI", has_flag("gfni"));
+#elif defined(__aarch64__)
+  if (read_flags("Features") != 0) {
+    return FIXTURE_SKIP;
+  }
+  int neon = has_flag("asimd");
+  cross_check(line, "NEON", neon);
+#ifdef HWCAP_SVE
+  cross_check(line, "SVE", neon && has_flag("sve"));
+#endif
+#ifdef HWCAP2_SVE2
+  cross_check(line, "SVE2", neon && has_flag("sve2"));
+#endif
+#ifdef HWCAP2_SME
+  cross_check(line, "SME", neon && has_flag("sme"));
+#endif
+  cross_check(line, "AES", has_flag("aes"));
+  cross_check(line, "SHA2", has_flag("sha2"));
+#ifdef HWCAP_SHA512
+  cross_check(line, "SHA512", has_flag("sha512"));
+#endif
+  cross_check(line, "LSE", has_flag("atomics"));
+#else
+  return FIXTURE_SKIP;
+#endif
+  return fixture_result();
+}
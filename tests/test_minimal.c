@@ -0,0 +1,75 @@
+// tinyfetch Copyright (C) 2024 kernaltrap8
+// This program comes with ABSOLUTELY NO WARRANTY
+// This is free software, and you are welcome to redistribute it
+// under certain conditions
+
+/*
+    test_minimal.c: size and startup time of the kernel/uptime/RAM build
+*/
+
+#include "fixture.h"
+
+#define MINIMAL_MAX_BYTES (32 * 1024)
+#define MINIMAL_MAX_STARTUP_MS 5.0 // mean over MINIMAL_RUNS
+#define MINIMAL_RUNS 200
+
+// runs the binary with stdout into out (or /dev/null), returns its status
+int run(const char *path, char *out, size_t size) {
+  int pipefd[2];
+  if (pipe(pipefd) != 0) {
+    return -1;
+  }
+  pid_t pid = fork();
+  if (pid == 0) {
+    int null = open("/dev/null", O_WRONLY);
+    dup2(out != NULL ? pipefd[1] : null, STDOUT_FILENO);
+    execl(path, path, (char *)NULL);
+    _exit(127);
+  }
+  close(pipefd[1]);
+  size_t len = 0;
+  ssize_t n;
+  while (out != NULL && len + 1 < size &&
+         (n = read(pipefd[0], out + len, size - len - 1)) > 0) {
+    len += n;
+  }
+  if (out != NULL) {
+    out[len] = '\0';
+  }
+  close(pipefd[0]);
+  int status = -1;
+  waitpid(pid, &status, 0);
+  return status;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc != 2) {
+    fprintf(stderr, "usage: %s <tinyfetch-minimal>\n", argv[0]);
+    return 1;
+  }
+  struct stat st;
+  CHECK(stat(argv[1], &st) == 0);
+  printf("size: %lld bytes (budget %d)\n", (long long)st.st_size,
+         MINIMAL_MAX_BYTES);
+  CHECK(st.st_size <= MINIMAL_MAX_BYTES);
+
+  // only the three compiled-in lines, and no flags for the rest
+  char out[4096];
+  CHECK(run(argv[1], out, sizeof(out)) == 0);
+  CHECK(strstr(out, pretext_kernel) != NULL);
+  CHECK(strstr(out, pretext_uptime) != NULL);
+  CHECK(strstr(out, pretext_ram) != NULL);
+  CHECK(strstr(out, pretext_OS) == NULL);
+  CHECK(strstr(out, pretext_distro) == NULL);
+  CHECK(strstr(out, pretext_processor) == NULL);
+
+  double start = fixture_now();
+  for (int i = 0; i < MINIMAL_RUNS; i++) {
+    CHECK(run(argv[1], NULL, 0) == 0);
+  }
+  double mean_ms = (fixture_now() - start) / MINIMAL_RUNS * 1e3;
+  printf("startup: %.3f ms mean over %d runs (budget %.1f)\n", mean_ms,
+         MINIMAL_RUNS, MINIMAL_MAX_STARTUP_MS);
+  CHECK(mean_ms <= MINIMAL_MAX_STARTUP_MS);
+  return fixture_result();
+}
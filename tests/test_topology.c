@@ -0,0 +1,92 @@
+// tinyfetch Copyright (C) 2024 kernaltrap8
+// This program comes with ABSOLUTELY NO WARRANTY
+// This is free software, and you are welcome to redistribute it
+// under certain conditions
+
+/*
+    test_topology.c: the Topology line on a 512-CPU sysfs fixture
+*/
+
+#include "fixture.h"
+
+#define FIXTURE_SOCKETS 2
+#define FIXTURE_CORES 256 // across both sockets, two threads each
+#define FIXTURE_CPUS (FIXTURE_CORES * 2)
+#define TOPOLOGY_TARGET_MS 1.0 // reported, what a quiet machine manages
+#define TOPOLOGY_LIMIT_MS 5.0  // enforced, with room for a loaded CI runner
+#define TOPOLOGY_RUNS 20
+
+// a dual-socket SMT2 machine, numbered the way the kernel does it: the
+// first thread of every core, then all the second threads
+void write_fixture(void) {
+  int per_socket = FIXTURE_CORES / FIXTURE_SOCKETS;
+  fixture_write("cpu/online", "0-%d\n", FIXTURE_CPUS - 1);
+  fixture_write("cpu/smt/control", "on\n");
+  for (int cpu = 0; cpu < FIXTURE_CPUS; cpu++) {
+    int core = cpu % FIXTURE_CORES;
+    int socket = core / per_socket;
+    char path[96];
+    snprintf(path, sizeof(path), "cpu/cpu%d/topology/thread_siblings_list",
+             cpu);
+    fixture_write(path, "%d,%d\n", core, core + FIXTURE_CORES);
+    snprintf(path, sizeof(path), "cpu/cpu%d/topology/package_cpus_list", cpu);
+    fixture_write(path, "%d-%d,%d-%d\n", socket * per_socket,
+                  socket * per_socket + per_socket - 1,
+                  FIXTURE_CORES + socket * per_socket,
+                  FIXTURE_CORES + socket * per_socket + per_socket - 1);
+  }
+  const char *caches[][4] = {{"1", "Data", "48K", "0,256"},
+                             {"1", "Instruction", "32K", "0,256"},
+                             {"2", "Unified", "2048K", "0,256"},
+                             {"3", "Unified", "327680K", "0-127,256-383"}};
+  for (int i = 0; i < 4; i++) {
+    char path[96];
+    snprintf(path, sizeof(path), "cpu/cpu0/cache/index%d/level", i);
+    fixture_write(path, "%s\n", caches[i][0]);
+    snprintf(path, sizeof(path), "cpu/cpu0/cache/index%d/type", i);
+    fixture_write(path, "%s\n", caches[i][1]);
+    snprintf(path, sizeof(path), "cpu/cpu0/cache/index%d/size", i);
+    fixture_write(path, "%s\n", caches[i][2]);
+    snprintf(path, sizeof(path), "cpu/cpu0/cache/index%d/shared_cpu_list", i);
+    fixture_write(path, "%s\n", caches[i][3]);
+  }
+}
+
+int main(void) {
+  fixture_init();
+  write_fixture();
+  int cpufd = open("cpu", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  CHECK(cpufd >= 0);
+
+  // the best of a few runs, so a busy CI host doesn't fail the budget
+  double best = 1e9;
+  for (int run = 0; run < TOPOLOGY_RUNS; run++) {
+    capture_start();
+    double start = fixture_now();
+    topology_line(cpufd);
+    double elapsed = fixture_now() - start;
+    capture_end();
+    best = (elapsed < best) ? elapsed : best;
+  }
+  printf("%s", fixture_out);
+  printf("%d CPUs scanned in %.3f ms (target %.1f, limit %.1f)\n",
+         FIXTURE_CPUS, best * 1e3, TOPOLOGY_TARGET_MS, TOPOLOGY_LIMIT_MS);
+  CHECK(best * 1e3 < TOPOLOGY_LIMIT_MS);
+  CHECK(strstr(fixture_out, "2 sockets, 128 cores each (256 total), "
+                            "512 threads (SMT on, 2/core)") != NULL);
+  CHECK(strstr(fixture_out, "L1d 48K (shared by 2)") != NULL);
+  CHECK(strstr(fixture_out, "L3 320M (shared by 256)") != NULL);
+
+  // smt/control's own words are mapped onto on/off/unsupported
+  const char *controls[][2] = {{"forceoff\n", "(SMT off,"},
+                               {"notsupported\n", "(SMT unsupported,"},
+                               {"notimplemented\n", "(SMT unsupported,"}};
+  for (int i = 0; i < 3; i++) {
+    fixture_write("cpu/smt/control", "%s", controls[i][0]);
+    capture_start();
+    topology_line(cpufd);
+    CHECK(strstr(capture_end(), controls[i][1]) != NULL);
+  }
+  close(cpufd);
+  return fixture_result();
+}
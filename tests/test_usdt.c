@@ -0,0 +1,48 @@
+// tinyfetch Copyright (C) 2024 kernaltrap8
+// This program comes with ABSOLUTELY NO WARRANTY
+// This is free software, and you are welcome to redistribute it
+// under certain conditions
+
+/*
+    test_usdt.c: the installed binary still carries its stapsdt notes
+*/
+
+#include "fixture.h"
+
+// -s and --gc-sections are free to drop sections nothing references, so
+// look at the real build output rather than trusting the header
+int main(int argc, char *argv[]) {
+  if (argc != 3) {
+    fprintf(stderr, "usage: %s <readelf> <tinyfetch>\n", argv[0]);
+    return 1;
+  }
+  char cmd[PATH_MAX * 2 + 16];
+  snprintf(cmd, sizeof(cmd), "'%s' -n '%s'", argv[1], argv[2]);
+  FILE *readelf = popen(cmd, "r");
+  CHECK(readelf != NULL);
+  if (readelf == NULL) {
+    return fixture_result();
+  }
+  size_t len = fread(fixture_out, 1, sizeof(fixture_out) - 1, readelf);
+  fixture_out[len] = '\0';
+  CHECK(pclose(readelf) == 0);
+
+  const char *names[] = {
+      "collector__entry",   "collector__return",
+      "file_parser__entry", "file_parser__return",
+#if PCI_DETECTION == 1
+      "gpu__entry",         "gpu__return",
+#endif
+  };
+  CHECK(strstr(fixture_out, "stapsdt") != NULL);
+  CHECK(strstr(fixture_out, "Provider: tinyfetch") != NULL);
+  for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+    char want[64];
+    snprintf(want, sizeof(want), "Name: %s\n", names[i]);
+    if (strstr(fixture_out, want) == NULL) {
+      printf("missing probe %s\n", names[i]);
+      fixture_failures++;
+    }
+  }
+  return fixture_result();
+}